@@ -243,7 +243,7 @@ private:
 
 	bool isShortOptionFlag(std::string str)
 	{
-		return (str.find("-") == 0 && str.find("--") != 0);
+		return (str.size() > 1 && str.find("-") == 0 && str.find("--") != 0); // a lone - is a value (stdin/stdout)
 	}
 
 	bool isLongOptionFlag(std::string str)
@@ -396,6 +396,20 @@ inline bool CliParser::parse(int numArgs, char *argStrs[])
       state = 0;
       curShortFlagName = "";
     }
+    else if (((state == 1) && (strcmp(argStrs[i - 1], "-nv") == 0)) ||
+      ((state == 1) && (strcmp(argStrs[i - 1], "--noisevolume") == 0)))
+    { // close option
+      endOptionFlag(curShortFlagName, argStr);
+      state = 0;
+      curShortFlagName = "";
+    }
+    else if (((state == 1) && (strcmp(argStrs[i - 1], "-lc") == 0)) ||
+      ((state == 1) && (strcmp(argStrs[i - 1], "--limiterceiling") == 0)))
+    { // close option
+      endOptionFlag(curShortFlagName, argStr);
+      state = 0;
+      curShortFlagName = "";
+    }
     else
     //END HACK!!
 
@@ -0,0 +1,521 @@
+/*--------------------------------------------------------------------------------
+ BeepBoxBench.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "BeepingCoreLib_api.h"
+
+#include "Globals.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Base/CliParser.hxx"
+#include "Mixer.h"
+
+#include "LoudnessStats.h"
+#include "Payload.h"
+#include "ToneSynth.h"
+#include "PlanarIO.h"
+#include "MappedWav.h"
+#include "BeepTrack.h"
+#include "BufferPool.h"
+#include "VRand.h"
+#include "Metrics.h"
+#include "StageTimers.h"
+
+// Benchmark of the file mixing pipeline on synthetic program material.
+//
+// Every case writes a deterministic program file (the same options give the same samples
+// on every run and host), then runs the stages of the file mix on it: read, deinterleave,
+// encode (native tone synthesizer), energy, stability, mix, interleave, write and
+// loudness. Mode 0 is mixed over the whole buffer, not block by block as BeepBoxMain
+// does when it can, so that every mode runs the same stages. Each case is run --repeats
+// times: the fastest time of every stage is kept, and the largest resident memory growth
+// (peak_rss_bytes_per_sample). Results go to a JSON file so that releases can be compared.
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifndef MIN
+#define MIN(a,b) ((a <= b) ? (a) : (b))
+#endif
+
+enum { kNoise = 0, kMusic = 1, kSpeech = 2, kNumMaterials = 3 };
+static const char *kMaterialNames[kNumMaterials] = { "noise", "music", "speech" };
+
+// stages in pipeline order, as named by the ScopedTimers
+static const char *kStages[] = { "read", "deinterleave", "encode", "energy", "stability", "mix", "interleave", "write", "loudness" };
+static const int kNumStages = sizeof(kStages) / sizeof(kStages[0]);
+
+static const int kBlockFrames = 4096;
+static const uint32_t kSeed = 20200716;
+
+struct BenchResult
+{
+  double wallSeconds;
+  double stageSeconds[kNumStages];
+  long poolBytes;
+  long rssBytes;          // resident memory growth up to the mix, the largest of the repeats is kept
+  double lufs;
+  uint64_t outputHash;
+};
+
+//comma separated list of numbers, e.g. "10,60,180"
+std::vector<float> parseList(const std::string &str)
+{
+  std::vector<float> values;
+  const char *p = str.c_str();
+  while (*p)
+  {
+    char *end;
+    float value = strtof(p, &end);
+    if (end == p)
+      break;
+    values.push_back(value);
+    p = (*end == ',') ? end + 1 : end;
+  }
+  return values;
+}
+
+//uniform number in [0, 1) for counter index of the generator
+inline float uniform(const VRandCounter &rng, uint64_t index)
+{
+  return rng.white(index, 0.5f) + 0.5f;
+}
+
+//pink noise at the same level on every channel, independent channels
+void synthNoise(float **out, int nch, long nFrames)
+{
+  for (int t = 0; t < nch; t++)
+  {
+    VRandCounter rng(kSeed, t);
+    rng.pinkBlock(0, out[t], (int)nFrames, 0.25f);
+  }
+}
+
+//chords of decaying harmonic notes changing every two seconds, a hi-hat on every half
+//second and a pink room tone. The chord is panned a little differently on each channel
+void synthMusic(float **out, int nch, long nFrames, float sampleRate)
+{
+  static const int kScale[] = { 0, 2, 4, 7, 9 }; //pentatonic
+  const long chordFrames = (long)(2.f * sampleRate);
+  const long beatFrames = (long)(0.5f * sampleRate);
+  const float decay = expf(-1.f / (0.8f * sampleRate));
+  const float hatDecay = expf(-1.f / (0.03f * sampleRate));
+  VRandCounter rng(kSeed, 100);
+
+  std::vector<float> chord(nFrames);
+  std::vector<float> hat(nFrames);
+  for (long start = 0, c = 0; start < nFrames; start += chordFrames, c++)
+  {
+    const long n = MIN(chordFrames, nFrames - start);
+    for (int k = 0; k < 3; k++)
+    {
+      int step = (int)(uniform(rng, c * 4 + k) * 15.f);
+      float midi = 48.f + 12.f * (step / 5) + kScale[step % 5];
+      double f0 = 440.0 * pow(2.0, (midi - 69.f) / 12.0);
+      float env = 0.12f;
+      for (long i = 0; i < n; i++)
+      {
+        double w = 2.0 * M_PI * f0 * i / sampleRate;
+        float v = 0.f;
+        for (int h = 1; h <= 4; h++)
+          v += (float)sin(w * h) / h;
+        chord[start + i] += v * env;
+        env *= decay;
+      }
+    }
+  }
+  VRandCounter hatNoise(kSeed, 101);
+  hatNoise.whiteBlock(0, &hat[0], (int)nFrames, 0.1f);
+  for (long start = 0; start < nFrames; start += beatFrames)
+  {
+    float env = 1.f;
+    const long n = MIN(beatFrames, nFrames - start);
+    for (long i = 0; i < n; i++, env *= hatDecay)
+      hat[start + i] *= env;
+  }
+
+  for (int t = 0; t < nch; t++)
+  {
+    VRandCounter room(kSeed, t);
+    room.pinkBlock(0, out[t], (int)nFrames, 0.005f);
+    float pan = (nch > 1) ? 0.6f + 0.4f * t / (nch - 1) : 1.f;
+    for (long i = 0; i < nFrames; i++)
+      out[t][i] += chord[i] * pan + hat[i];
+  }
+}
+
+//phrases of syllables (a pulse train through two formant resonators, with a noise part)
+//separated by pauses, about half of the time is silence. The voice is on the center
+//channel when there is one, on every channel otherwise, under a -70 dB noise floor
+void synthSpeech(float **out, int nch, long nFrames, float sampleRate)
+{
+  std::vector<float> voice(nFrames, 0.f);
+  VRandCounter rng(kSeed, 200);
+  VRandCounter breath(kSeed, 201);
+  uint64_t event = 0;
+
+  long pos = (long)(0.3f * sampleRate);
+  while (pos < nFrames)
+  {
+    //a phrase of 3 to 12 syllables
+    int syllables = 3 + (int)(uniform(rng, event++) * 10.f);
+    for (int s = 0; (s < syllables) && (pos < nFrames); s++)
+    {
+      long len = (long)((0.12f + 0.18f * uniform(rng, event++)) * sampleRate);
+      float f0 = 100.f + 100.f * uniform(rng, event++);
+      float formant[2] = { 300.f + 600.f * uniform(rng, event++), 900.f + 1800.f * uniform(rng, event++) };
+      float noiseAmount = 0.3f * uniform(rng, event++);
+
+      //two-pole resonators
+      float a1[2], a2[2], y1[2] = { 0.f, 0.f }, y2[2] = { 0.f, 0.f };
+      for (int k = 0; k < 2; k++)
+      {
+        float r = expf(-(float)M_PI * 120.f / sampleRate);
+        a1[k] = 2.f * r * cosf(2.f * (float)M_PI * formant[k] / sampleRate);
+        a2[k] = -r * r;
+      }
+
+      const long n = MIN(len, nFrames - pos);
+      const float period = sampleRate / f0;
+      float phase = 0.f;
+      for (long i = 0; i < n; i++)
+      {
+        float x = 0.f;
+        phase += 1.f;
+        if (phase >= period)
+        {
+          phase -= period;
+          x = 1.f;
+        }
+        x += noiseAmount * breath.white(pos + i, 0.5f);
+        float y = 0.f;
+        for (int k = 0; k < 2; k++)
+        {
+          float v = x + a1[k] * y1[k] + a2[k] * y2[k];
+          y2[k] = y1[k];
+          y1[k] = v;
+          y += v;
+        }
+        float env = 0.5f - 0.5f * cosf(2.f * (float)M_PI * i / len);
+        voice[pos + i] = 0.02f * y * env;
+      }
+      pos += len + (long)((0.03f + 0.05f * uniform(rng, event++)) * sampleRate);
+    }
+    pos += (long)((0.4f + 1.1f * uniform(rng, event++)) * sampleRate);
+  }
+
+  const int voiceChannel = (nch >= 3) ? 2 : -1;
+  for (int t = 0; t < nch; t++)
+  {
+    VRandCounter noiseFloor(kSeed, t);
+    noiseFloor.pinkBlock(0, out[t], (int)nFrames, 0.0003f);
+    if ((voiceChannel < 0) || (t == voiceChannel))
+      for (long i = 0; i < nFrames; i++)
+        out[t][i] += voice[i];
+  }
+}
+
+//writes the program material of a case as a 16 bits WAV file
+int writeProgram(const char *filename, int material, int nch, long nFrames, float sampleRate)
+{
+  BufferPool bufferPool;
+  float **ppProgram = bufferPool.allocatePlanar(nch, nFrames);
+  float *pInterleaved = bufferPool.allocate((size_t)kBlockFrames * nch);
+  if (!ppProgram || !pInterleaved)
+    return -3;
+
+  if (material == kNoise)
+    synthNoise(ppProgram, nch, nFrames);
+  else if (material == kMusic)
+    synthMusic(ppProgram, nch, nFrames, sampleRate);
+  else
+    synthSpeech(ppProgram, nch, nFrames, sampleRate);
+
+  MappedWavWriter writer;
+  if (writer.create(filename, nch, (int)sampleRate, nFrames, PcmConvert::kPcm16) != MappedWav::kOk)
+    return -4;
+  for (long done = 0; done < nFrames; )
+  {
+    int n = (int)MIN((long)kBlockFrames, nFrames - done);
+    PlanarIO::interleave(ppProgram, done, n, nch, pInterleaved);
+    writer.write(pInterleaved, n);
+    done += n;
+  }
+  return (writer.close() == MappedWav::kOk) ? 0 : -4;
+}
+
+//FNV-1a of a whole file, changes when any output sample changes
+uint64_t hashFile(const char *filename)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  FILE *file = fopen(filename, "rb");
+  if (!file)
+    return 0;
+  std::vector<unsigned char> block(1 << 16);
+  size_t n;
+  while ((n = fread(&block[0], 1, block.size(), file)) > 0)
+    for (size_t i = 0; i < n; i++)
+      hash = (hash ^ block[i]) * 0x100000001b3ULL;
+  fclose(file);
+  return hash;
+}
+
+//one run of the file mix pipeline, stages as in BeepBoxMain
+int runPipeline(const char *inputFn, const char *outputFn, int mixmode, BenchResult &result)
+{
+  const int64_t start = Metrics::now();
+  const long rssStart = Metrics::getResidentBytes();
+  StageTimers::reset();
+  BufferPool bufferPool;
+
+  MappedWavReader input;
+  if (input.open(inputFn) != MappedWav::kOk)
+    return -2;
+  const int nch = input.getChannels();
+  const long nFrames = input.getFrames();
+  const float sampleRate = (float)input.getSampleRate();
+
+  float *pInterleaved = bufferPool.allocate((size_t)kBlockFrames * nch);
+  float **ppBuffer = bufferPool.allocatePlanar(nch, nFrames);
+  float *pBeepsBuffer = bufferPool.allocate(nFrames);
+  if (!pInterleaved || !ppBuffer || !pBeepsBuffer)
+    return -3;
+
+  //READ
+  long readFrames = 0;
+  while (readFrames < nFrames)
+  {
+    int n;
+    {
+      ScopedTimer timer("read");
+      n = input.read(pInterleaved, (int)MIN((long)kBlockFrames, nFrames - readFrames));
+    }
+    if (n <= 0)
+      break;
+    ScopedTimer timer("deinterleave");
+    PlanarIO::deinterleave(pInterleaved, n, nch, ppBuffer, readFrames);
+    readFrames += n;
+  }
+  input.close();
+  for (int t = 0; t < nch; t++) //truncated file
+    memset(ppBuffer[t] + readFrames, 0, (nFrames - readFrames) * sizeof(float));
+
+  //ENCODE, marks every 10 seconds from 5 seconds as with the default options
+  ToneSynth toneSynth;
+  if (toneSynth.configure(BEEPING_MODE_NONAUDIBLE, sampleRate, 12000.f, 1) < 0)
+    return -1;
+  BeepTrack track(&toneSynth, (uint32_t)Payload::packKey("01234"), sampleRate, 128, 5.0, 10.0, Globals::durToken * 20.0);
+  for (long done = 0; done < nFrames; )
+  {
+    int n = (int)MIN((long)kBlockFrames, nFrames - done);
+    ScopedTimer timer("encode");
+    track.render(pBeepsBuffer + done, n, 1.f);
+    done += n;
+  }
+
+  //MIX, in place over the program buffers
+  Mixer mixer;
+  mixer.setBeepLevel(-3.f);
+  mixer.setMinBeepLevel(-20.f);
+  mixer.setProgramLevel(0.f);
+  mixer.setMode(mixmode);
+  mixer.setUseNormalize(false);
+  mixer.mix((const float**)ppBuffer, nFrames, nch, sampleRate, pBeepsBuffer, ppBuffer);
+  result.rssBytes = Metrics::getResidentBytes() - rssStart;
+
+  //WRITE and measure the output
+  MappedWavWriter output;
+  if (output.create(outputFn, nch, (int)sampleRate, nFrames, PcmConvert::kPcm16) != MappedWav::kOk)
+    return -4;
+  output.setGain(mixer.getOutputGain());
+  LoudnessMeter meter;
+  meter.configure(nch, sampleRate);
+  meter.setGain(mixer.getOutputGain());
+  for (long done = 0; done < nFrames; )
+  {
+    int n = (int)MIN((long)kBlockFrames, nFrames - done);
+    {
+      ScopedTimer timer("interleave");
+      PlanarIO::interleave(ppBuffer, done, n, nch, pInterleaved);
+    }
+    {
+      ScopedTimer timer("write");
+      output.write(pInterleaved, n);
+    }
+    {
+      ScopedTimer timer("loudness");
+      meter.add(pInterleaved, n);
+    }
+    done += n;
+  }
+  if (output.close() != MappedWav::kOk)
+    return -4;
+
+  result.wallSeconds = (Metrics::now() - start) * 1e-9;
+  for (int s = 0; s < kNumStages; s++)
+    result.stageSeconds[s] = StageTimers::getTotalSeconds(kStages[s]);
+  result.poolBytes = (long)bufferPool.getBytesReserved();
+  result.lufs = meter.getGlobalLoudness();
+  return 0;
+}
+
+//x real time, null when the stage took no measurable time
+void printXrt(FILE *file, double audioSeconds, double seconds)
+{
+  if (seconds > 0.0)
+    fprintf(file, "%.1f", audioSeconds / seconds);
+  else
+    fprintf(file, "null");
+}
+
+int main(int argc, char** argv)
+{
+  CliParser cliParser;
+  cliParser.addOption("o", "output", CliParser::CLI_STRING, true, "filename", "Filename of the JSON results", "bench.json");
+  cliParser.addOption("d", "durations", CliParser::CLI_STRING, true, "values", "Durations of the program material in seconds, comma separated (e.g. 10,60,180)", "10,60,180");
+  cliParser.addOption("c", "channels", CliParser::CLI_STRING, true, "values", "Channel counts, comma separated (e.g. 1,2,6)", "1,2,6");
+  cliParser.addOption("x", "mixmodes", CliParser::CLI_STRING, true, "values", "Mixing modes, comma separated (0: DefaultLevel, 1: GlobalLevel, 2: DynamicLevel)", "0,1,2");
+  cliParser.addOption("r", "samplerate", CliParser::CLI_FLOAT, true, "value", "Sampling rate of the program material (e.g. 44100.0 or 48000.0)", "44100.0");
+  cliParser.addOption("n", "repeats", CliParser::CLI_INT, true, "value", "Runs of each case, the fastest time of each stage is kept (e.g. 3)", "3");
+  cliParser.addOption("w", "workdir", CliParser::CLI_STRING, true, "directory", "Directory for the program and output files of the cases", "/tmp");
+
+  if (cliParser.parse(argc, argv) != true)
+  {
+    std::cerr << cliParser.generateUsageMessage();
+    return 0;
+  }
+
+  std::string outputFnStr = cliParser.getOptionAsString("o", "bench.json");
+  std::vector<float> durations = parseList(cliParser.getOptionAsString("d", "10,60,180"));
+  std::vector<float> channels = parseList(cliParser.getOptionAsString("c", "1,2,6"));
+  std::vector<float> mixmodes = parseList(cliParser.getOptionAsString("x", "0,1,2"));
+  const float sampleRate = cliParser.getOptionAsFloat("r", 44100.0);
+  const int repeats = cliParser.getOptionAsInt("n", 3);
+  std::string workDirStr = cliParser.getOptionAsString("w", "/tmp");
+
+  if (durations.empty() || channels.empty() || mixmodes.empty() || (repeats < 1) || (sampleRate < 8000.f))
+  {
+    std::cerr << "Nothing to run, check the durations, channels, mix modes, repeats and sampling rate" << std::endl;
+    return -1;
+  }
+
+  FILE *file = fopen(outputFnStr.c_str(), "w");
+  if (!file)
+  {
+    std::cerr << "Cannot create " << outputFnStr.c_str() << std::endl;
+    return -1;
+  }
+
+  char host[256] = "unknown";
+  gethostname(host, sizeof(host) - 1);
+  char date[32];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+  fprintf(file, "{\n\"version\":\"1.1.0\",\"date\":\"%s\",\"host\":\"%s\",\"compiler\":\"%s\",\"samplerate\":%g,\"repeats\":%d,\n\"cases\":[",
+          date, host, __VERSION__, sampleRate, repeats);
+
+  //the mixer and the writers report their progress on std::cout
+  std::streambuf *coutBuffer = std::cout.rdbuf();
+  StageTimers::enable(false);
+
+  const std::string inputFnStr = workDirStr + "/beepbox_bench_in.wav";
+  const std::string mixFnStr = workDirStr + "/beepbox_bench_out.wav";
+  int error = 0;
+  bool first = true;
+  for (int m = 0; (m < kNumMaterials) && !error; m++)
+  for (int d = 0; (d < (int)durations.size()) && !error; d++)
+  for (int c = 0; (c < (int)channels.size()) && !error; c++)
+  {
+    const int nch = (int)channels[c];
+    const long nFrames = (long)(durations[d] * sampleRate);
+    if ((nch < 1) || (nFrames < 1))
+      continue;
+    error = writeProgram(inputFnStr.c_str(), m, nch, nFrames, sampleRate);
+
+    for (int x = 0; (x < (int)mixmodes.size()) && !error; x++)
+    {
+      const int mixmode = (int)mixmodes[x];
+      BenchResult best;
+      for (int r = 0; (r < repeats) && !error; r++)
+      {
+        BenchResult result;
+        std::cout.rdbuf(NULL);
+        error = runPipeline(inputFnStr.c_str(), mixFnStr.c_str(), mixmode, result);
+        std::cout.rdbuf(coutBuffer);
+        if (error)
+          break;
+        if (r == 0)
+        {
+          best = result;
+          best.outputHash = hashFile(mixFnStr.c_str());
+          continue;
+        }
+        best.wallSeconds = MIN(best.wallSeconds, result.wallSeconds);
+        for (int s = 0; s < kNumStages; s++)
+          best.stageSeconds[s] = MIN(best.stageSeconds[s], result.stageSeconds[s]);
+        if (result.rssBytes > best.rssBytes)
+          best.rssBytes = result.rssBytes;
+      }
+      if (error)
+        break;
+
+      const double audioSeconds = nFrames / sampleRate;
+      const double samples = (double)nFrames * nch;
+      fprintf(file, "%s\n{\"material\":\"%s\",\"duration\":%g,\"channels\":%d,\"mixmode\":%d,\"frames\":%ld,",
+              first ? "" : ",", kMaterialNames[m], durations[d], nch, mixmode, nFrames);
+      fprintf(file, "\"seconds\":%.6f,\"xrt\":", best.wallSeconds);
+      printXrt(file, audioSeconds, best.wallSeconds);
+      fprintf(file, ",\"pool_bytes_per_sample\":%.2f,\"peak_rss_bytes_per_sample\":%.2f,\"lufs\":%.2f,\"output_hash\":\"%016llx\",\"stages\":{",
+              best.poolBytes / samples, best.rssBytes / samples, best.lufs, (unsigned long long)best.outputHash);
+      bool firstStage = true;
+      for (int s = 0; s < kNumStages; s++)
+      {
+        if (best.stageSeconds[s] <= 0.0) //stage did not run
+          continue;
+        fprintf(file, "%s\"%s\":{\"seconds\":%.6f,\"xrt\":", firstStage ? "" : ",", kStages[s], best.stageSeconds[s]);
+        printXrt(file, audioSeconds, best.stageSeconds[s]);
+        fprintf(file, "}");
+        firstStage = false;
+      }
+      fprintf(file, "}}");
+      first = false;
+
+      printf("%-6s %6gs %dch mode %d: %8.3f s %8.1fx real time\n", kMaterialNames[m], durations[d], nch, mixmode,
+             best.wallSeconds, (best.wallSeconds > 0.0) ? audioSeconds / best.wallSeconds : 0.0);
+      fflush(stdout);
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  bool writeError = (ferror(file) != 0);
+  if (fclose(file) != 0)
+    writeError = true;
+  unlink(inputFnStr.c_str());
+  unlink(mixFnStr.c_str());
+
+  if (error)
+  {
+    std::cerr << "Benchmark stopped, error " << error << " (-2: cannot read, -3: out of memory, -4: cannot write)" << std::endl;
+    return error;
+  }
+  if (writeError)
+  {
+    std::cerr << "Cannot write " << outputFnStr.c_str() << std::endl;
+    return -1;
+  }
+  std::cout << "Results written to " << outputFnStr.c_str() << std::endl;
+  return 0;
+}
@@ -20,6 +20,26 @@
 #include "Mixer.h"
 
 #include "LoudnessStats.h"
+#include "LoudnessTimeline.h"
+#include "Scanner.h"
+#include "WatchList.h"
+#include "Payload.h"
+#include "MarkCode.h"
+#include "ToneSynth.h"
+#include "PlanarIO.h"
+#include "MappedWav.h"
+#include "PcmStream.h"
+#include "BeepTrack.h"
+#include "OutputWriter.h"
+#include "StreamPipeline.h"
+#include "BufferPool.h"
+#include "Resampler.h"
+#include "VRand.h"
+#include "Metrics.h"
+#include "StageTimers.h"
+
+#include <fcntl.h>
+#include <unistd.h>
 
 
 #ifndef MIN
@@ -43,111 +63,96 @@ void showVersion(int silentMode)
   }
 }
 
-char getCharFromIdx(int idx)
+int getBeepingMode(int param_mode)
 {
-  if      (idx==0)  return '0';
-  else if (idx==1)  return '1';
-  else if (idx==2)  return '2';
-  else if (idx==3)  return '3';
-  else if (idx==4)  return '4';
-  else if (idx==5)  return '5';
-  else if (idx==6)  return '6';
-  else if (idx==7)  return '7';
-  else if (idx==8)  return '8';
-  else if (idx==9)  return '9';
-  else if (idx==10) return 'a';
-  else if (idx==11) return 'b';
-  else if (idx==12) return 'c';
-  else if (idx==13) return 'd';
-  else if (idx==14) return 'e';
-  else if (idx==15) return 'f';
-  else if (idx==16) return 'g';
-  else if (idx==17) return 'h';
-  else if (idx==18) return 'i';
-  else if (idx==19) return 'j';
-  else if (idx==20) return 'k';
-  else if (idx==21) return 'l';
-  else if (idx==22) return 'm';
-  else if (idx==23) return 'n';
-  else if (idx==24) return 'o';
-  else if (idx==25) return 'p';
-  else if (idx==26) return 'q';
-  else if (idx==27) return 'r';
-  else if (idx==28) return 's';
-  else if (idx==29) return 't';
-  else if (idx==30) return 'u';
-  else if (idx==31) return 'v';
-  else              return '0';
+  //enum BEEPING_MODE { BEEPING_MODE_AUDIBLEOLD = 0, BEEPING_MODE_NONAUDIBLEOLD = 1, BEEPING_MODE_AUDIBLE = 2, BEEPING_MODE_NONAUDIBLE = 3, BEEPING_MODE_HIDDEN = 4, BEEPING_MODE_ALL = 5, BEEPING_MODE_CUSTOM = 6 };
+  int mode = /*BEEPING_MODE::*/BEEPING_MODE_NONAUDIBLE; //2 audible, 3 non-audible
+  if (param_mode == 0)
+    mode = /*BEEPING_MODE::*/BEEPING_MODE_AUDIBLE;
+  else if (param_mode == 1)
+    mode = /*BEEPING_MODE::*/BEEPING_MODE_HIDDEN;
+  else if (param_mode == 2)
+    mode = /*BEEPING_MODE::*/BEEPING_MODE_NONAUDIBLE;
+  else if (param_mode == 3)
+    mode = /*BEEPING_MODE::*/BEEPING_MODE_CUSTOM;
+  return mode;
 }
 
-//e.g. hj abcdefghij n9du84bb
-
-char *fromDecToBase(int num, int rad)
+//BeepingCore marks at 44.1Khz or 48Khz, other rates are converted to the closest family
+float getMarkingRate(float sampleRate)
 {
-  char digits[] = "0123456789abcdefghijklmnopqrstuvWXYZabcdefghijklmnopqrstuvwxyz";
-  int i;
-  char buf[66];   /* enough space for any 64-bit in base 2 */
-  buf[0]=0;
+  long rate = (long)(sampleRate + 0.5f);
+  if ((rate % 11025) == 0)
+    return 44100.f;
+  if ((rate % 8000) == 0)
+    return 48000.f;
+  return (sampleRate > 46000.f) ? 48000.f : 44100.f;
+}
 
-  /* bounds check for radix */
-  if (rad < 2 || rad > 62)
+//converts every channel of a planar buffer, the new buffers come from the pool
+float **resamplePlanar(BufferPool &bufferPool, float **ppIn, int nch, long nFrames, float inRate, float outRate, long outFrames)
+{
+  float **ppOut = bufferPool.allocatePlanar(nch, outFrames);
+  if (!ppOut)
+    return NULL;
+  for (int t = 0; t < nch; t++)
+    if (Resampler::convert(ppIn[t], nFrames, inRate, outRate, ppOut[t], outFrames) < 0)
       return NULL;
-  /* if num is zero */
-  if (!num)
-      //return StrDup("0");
-      return strdup("0");
-
-  /* null terminate buf, and set i at end */
-  buf[65] = '\0';
-  i = 65;
-
-  if (num > 0) {  /* if positive... */
-      while (num) { /* until num is 0... */
-          /* go left 1 digit, divide by radix, and set digit to remainder */
-          buf[--i] = digits[num % rad];
-          num /= rad;
-      }
-  } else {    /* same for negative, but negate the modulus and prefix a '-' */
-      while (num) {
-          buf[--i] = digits[-(num % rad)];
-          num /= rad;
-      }
-      buf[--i] = '-';
-  }
-  /* return a duplicate of the used portion of buf */
-  //return StrDup(buf + i);
-  return strdup(buf + i);
+  return ppOut;
+}
+
+//copies n mono samples to every channel of nch interleaved frames, scaled by the channel gains
+void spreadToChannels(const float *mono, int n, int nch, const std::vector<float> &gains, float *interleaved)
+{
+  for (int i = 0; i < n; i++)
+    for (int t = 0; t < nch; t++)
+      interleaved[i*nch + t] = gains[t] * mono[i];
 }
 
-//int fromBaseToDec(char* number, int base)
+//absolute peak of n samples
+float getPeak(const float *buffer, long n, float peak)
+{
+  for (long i = 0; i < n; i++)
+    peak = MAX(peak, fabsf(buffer[i]));
+  return peak;
+}
 
-int charToVal(char curChar)
+//adds frames index.. of the noise bed to n interleaved frames, one noise stream per channel
+void addNoiseBed(std::vector<VRandCounter> &noise, int noiseBed, float noiseLevel, uint64_t index, float *scratch, int n, int nch, float *interleaved)
 {
-  char convArray[] =
-  {'0','1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v' };
-  for(int i=0;i<32; ++i)
+  for (int t = 0; t < nch; t++)
   {
-    if(curChar==convArray[i])
-    {
-      return i;
-    }
+    if (noiseBed == 1)
+      noise[t].whiteBlock(index, scratch, n, noiseLevel);
+    else if (noiseBed == 2)
+      noise[t].pinkBlock(index, scratch, n, noiseLevel);
+    else
+      noise[t].brownBlock(index, scratch, n, noiseLevel);
+    for (int i = 0; i < n; i++)
+      interleaved[i*nch + t] += scratch[i];
   }
-  return -1;
 }
 
-int fromBaseToDec(char * number, int length, int rad)
+//closes the loudness timeline written with the output and reports it
+void closeTimeline(LoudnessTimeline &timeline, const std::string &filename)
 {
-  int decimal = 0;
-  int factor = 1;
-  //std::cout << length;
-  for (int i=length-1; i >=0; --i)
-  {
-    int curVal = charToVal(number[i]);
-    decimal += factor*curVal;
-    factor*=rad;
-  }
-  //std::cout << decimal << std::endl;
-  return decimal;
+  long points = timeline.getNumPoints();
+  if (timeline.close() != LoudnessTimeline::kOk)
+    std::cerr << "Cannot write loudness timeline " << filename.c_str() << std::endl;
+  else
+    std::cout << "Loudness timeline: " << points << " points, LRA " << timeline.getLoudnessRange() << " LU" << std::endl;
+}
+
+//reports the stage timers when they are enabled and the wall time since start
+void printTotalDuration(int64_t start, int timers, const std::string &traceFnStr)
+{
+  if (timers == 1)
+    StageTimers::printSummary();
+  if ((traceFnStr.size() > 0) && (StageTimers::writeTrace(traceFnStr.c_str()) < 0))
+    std::cerr << "Cannot write trace " << traceFnStr.c_str() << std::endl;
+
+  double totalDuration = (Metrics::now() - start) * 1e-9;
+  std::cout << "Total Duration: " << totalDuration << " secs" << std::endl;
 }
 
 int main(int argc, char** argv)
@@ -157,27 +162,57 @@ int main(int argc, char** argv)
   // Handle command line interface:
   CliParser cliParser;
   cliParser.addOption("m", "mode", CliParser::CLI_INT, true, "value", "Beeping Mode (0:audible, 1:hidden, 2:non-audible, 3:custom)", "2");
-  cliParser.addOption("f", "file", CliParser::CLI_STRING, true, "filename", "Input filename (.wav) to mix with beeps", "");
+  cliParser.addOption("f", "file", CliParser::CLI_STRING, true, "filename", "Input filename (.wav) to mix with beeps, - to stream from stdin", "");
   cliParser.addOption("k", "key", CliParser::CLI_STRING, false, "key", "Key identifier (5 characters) to encode in output audio (e.g. 01234)", "");
   cliParser.addOption("d", "duration", CliParser::CLI_FLOAT, true, "value", "Duration of output file in seconds (>=5.1)", "5.1");
   cliParser.addOption("i", "interval", CliParser::CLI_FLOAT, true, "value", "Interval in seconds (>=2.5) between two audio marks (e.g. 10)", "2.5");
   cliParser.addOption("s", "start", CliParser::CLI_FLOAT, true, "value", "Start time of the first audio mark in seconds (>2.2) (e.g. 2.5)", "5");
-  cliParser.addOption("o", "output", CliParser::CLI_STRING, false, "filename", "Filename of output audio file that will be written (.wav)", "");
+  cliParser.addOption("o", "output", CliParser::CLI_STRING, false, "filename", "Filename of output audio file that will be written (.wav), - for stdout when streaming", "");
+  cliParser.addOption("of", "outputformat", CliParser::CLI_INT, true, "value", "Output file format (0: wav 16 bits, 1: wav 24 bits, 2: wav float, 3: flac, 4: ogg vorbis)", "0");
+  cliParser.addOption("sy", "syncoutput", CliParser::CLI_INT, true, "value", "Wait until the output file is on the disk before exiting (0: disabled, 1: enabled)", "0");
 
   cliParser.addOption("x", "mixmode", CliParser::CLI_INT, true, "value", "Mixing mode (0: DefaultLevel, 1: GlobalLevel, 2: DynamicLevel)", "0");
   cliParser.addOption("v", "volumebeeps", CliParser::CLI_FLOAT, true, "value", "Set default beeps level in DB", "-3.0"); //see Cliparser hack to allow negative values
   cliParser.addOption("p", "volumeprogram", CliParser::CLI_FLOAT, true, "value", "Set default program level in DB", "0.0"); //see Cliparser hack to allow negative values
+  cliParser.addOption("bc", "beepchannels", CliParser::CLI_INT, true, "value", "Channels that receive the beeps (0: all channels, LFE included, 1: center only, 2: front left/right)", "0");
+  cliParser.addOption("lm", "limiter", CliParser::CLI_INT, true, "value", "Look-ahead true-peak limiter instead of hard clipping the mix (0: disabled, 1: enabled)", "0");
+  cliParser.addOption("lc", "limiterceiling", CliParser::CLI_FLOAT, true, "value", "Ceiling of the limiter in dBTP (e.g. -1.0)", "-1.0"); //see Cliparser hack to allow negative values
+  cliParser.addOption("nm", "normalize", CliParser::CLI_INT, true, "value", "Normalize the mix peak to full scale while writing the output file (0: disabled, 1: enabled)", "0");
+  cliParser.addOption("nb", "noisebed", CliParser::CLI_INT, true, "value", "Noise bed mixed under the beeps when only generating beeps (0: disabled, 1: white, 2: pink, 3: brown)", "0");
+  cliParser.addOption("nv", "noisevolume", CliParser::CLI_FLOAT, true, "value", "Set peak level of the noise bed in DB", "-60.0"); //see Cliparser hack to allow negative values
+  cliParser.addOption("ns", "noiseseed", CliParser::CLI_INT, true, "value", "Seed of the noise bed, the same seed gives the same noise (0: seeded from the clock)", "1");
+  cliParser.addOption("gc", "generatechannels", CliParser::CLI_INT, true, "value", "Number of channels of the output when only generating beeps (e.g. 1, 2 or 6)", "1");
 
   cliParser.addOption("r", "samplerate", CliParser::CLI_FLOAT, true, "value", "Sampling rate for output file (e.g. 44100.0 or 48000.0)", "44100.0");
 
   cliParser.addOption("l", "loudnessstatistics", CliParser::CLI_INT, true, "value", "Loudness statistics including LKFS and True Peak (0: disabled, 1:enabled)", "0");
 
+  cliParser.addOption("lt", "loudnesstimeline", CliParser::CLI_STRING, true, "filename", "Momentary and short-term loudness and LRA of the output over time, measured while it is written", "");
+  cliParser.addOption("lh", "loudnesshop", CliParser::CLI_FLOAT, true, "value", "Time in seconds between two points of the loudness timeline (e.g. 0.1)", "0.1");
+  cliParser.addOption("lf", "loudnessformat", CliParser::CLI_INT, true, "value", "Format of the loudness timeline (0: csv, 1: binary)", "0");
+  cliParser.addOption("mt", "metrics", CliParser::CLI_STRING, true, "filename", "JSON lines report of the running stage (samples, x real time, memory, ETA), - for stderr", "");
+  cliParser.addOption("mi", "metricsinterval", CliParser::CLI_INT, true, "value", "Time in milliseconds between two lines of the metrics report (e.g. 1000)", "1000");
+  cliParser.addOption("tm", "timers", CliParser::CLI_INT, true, "value", "Table of the wall time spent in each stage and thread (0: disabled, 1: enabled)", "0");
+  cliParser.addOption("tt", "trace", CliParser::CLI_STRING, true, "filename", "Chrome trace event file (.json) of the stages, for chrome://tracing or Perfetto", "");
   cliParser.addOption("bf", "basefreq", CliParser::CLI_FLOAT, true, "value", "Base Frequency in Hz for beeping custom mode  (e.g. 12000.0)", "12000.0");
   cliParser.addOption("ts", "tonesseparation", CliParser::CLI_INT, true, "value", "Separation between tones (1: minimum separation, 20:maximum separation)", "1");
 
   cliParser.addOption("sm", "synthmode", CliParser::CLI_INT, true, "value", "Synthesis mixed with beeps (0: disabled, 1: r2d2)", "0");
   cliParser.addOption("sv", "synthvolume", CliParser::CLI_FLOAT, true, "value", "Set volume of synth in DB related to beeps volume", "0.0");
 
+  cliParser.addOption("ri", "rawinput", CliParser::CLI_INT, true, "value", "Streamed input is headerless 16 bits PCM at --samplerate (0: WAVE, 1: raw)", "0");
+  cliParser.addOption("rc", "rawchannels", CliParser::CLI_INT, true, "value", "Number of channels of raw streamed input", "2");
+  cliParser.addOption("ro", "rawoutput", CliParser::CLI_INT, true, "value", "Streamed output is headerless 16 bits PCM (0: WAVE, 1: raw)", "0");
+
+  cliParser.addOption("ne", "nativeencoder", CliParser::CLI_INT, true, "value", "Render beeps with the native tone synthesizer instead of BeepingCore, only tones (0: disabled, 1: enabled)", "0");
+  cliParser.addOption("sc", "synthcheck", CliParser::CLI_INT, true, "value", "Compare and benchmark the native tone synthesizer against BeepingCore on one mark (0: disabled, 1: enabled)", "0");
+
+  cliParser.addOption("dc", "decode", CliParser::CLI_INT, true, "value", "Decode audio marks found in input file instead of writing output (0: disabled, 1: enabled)", "0");
+  cliParser.addOption("dm", "decimate", CliParser::CLI_INT, true, "value", "Decimating front-end for custom mode decoding (0: disabled, 1: enabled)", "0");
+  cliParser.addOption("w", "watchlist", CliParser::CLI_STRING, true, "filename", "Text file with one key per line to match against decoded marks", "");
+  cliParser.addOption("vf", "verify", CliParser::CLI_INT, true, "value", "Verify decoded marks against the schedule given by key, start, interval and duration (0: disabled, 1: enabled)", "0");
+  cliParser.addOption("wr", "watchreport", CliParser::CLI_STRING, true, "filename", "Filename of the watch list report (.csv) with hit counts and first/last times per key", "");
+
   if (cliParser.parse(argc, argv) != true)
   {
     std::cerr << "" << std::endl;
@@ -195,8 +230,7 @@ int main(int argc, char** argv)
 
   int i = 0;
 
-  clock_t total_start,total_end;
-  total_start = clock();
+  const int64_t total_start = Metrics::now(); //wall time, not the cpu time of the process
 
   //const int param_mode = cliParser.getOptionAsInt("m", 2);
   const int param_mode = 2;
@@ -206,16 +240,36 @@ int main(int argc, char** argv)
   const float interval = cliParser.getOptionAsFloat("i", 10.0);
   float startTime = cliParser.getOptionAsFloat("s", 5.0);
   std::string outputFnStr = cliParser.getOptionAsString("o", "");
+  const int outputFormat = cliParser.getOptionAsInt("of", OutputFormat::kWav16);
+  const int syncOutput = cliParser.getOptionAsInt("sy", 0);
 
   const int mixmode = cliParser.getOptionAsInt("x", 0);
   const float volumebeeps = cliParser.getOptionAsFloat("v", -3.f);
   const float volumeprogram = cliParser.getOptionAsFloat("p", 0.f);
+  const int beepChannels = cliParser.getOptionAsInt("bc", kBeepAllChannels);
+  const int generateChannels = cliParser.getOptionAsInt("gc", 1);
+  const int limiter = cliParser.getOptionAsInt("lm", 0);
+  const float limiterCeiling = cliParser.getOptionAsFloat("lc", -1.f);
+  const int normalize = cliParser.getOptionAsInt("nm", 0);
+  const int noiseBed = cliParser.getOptionAsInt("nb", 0);
+  const float noiseVolume = cliParser.getOptionAsFloat("nv", -60.f);
+  const int noiseSeed = cliParser.getOptionAsInt("ns", 1);
 
   //double sampleRate = 44100.0;
   //float sampleRate = 22050.f;
   const float sampleRate = cliParser.getOptionAsFloat("r", 44100.0);
 
   const int loudnessStats = cliParser.getOptionAsInt("l", 0);
+  std::string timelineFnStr = cliParser.getOptionAsString("lt", "");
+  const float timelineHop = cliParser.getOptionAsFloat("lh", 0.1f);
+  const int timelineFormat = cliParser.getOptionAsInt("lf", LoudnessTimeline::kCsv);
+  const bool useTimeline = (timelineFnStr.size() > 0);
+  std::string metricsFnStr = cliParser.getOptionAsString("mt", "");
+  const int metricsInterval = cliParser.getOptionAsInt("mi", 1000);
+  const int timers = cliParser.getOptionAsInt("tm", 0);
+  std::string traceFnStr = cliParser.getOptionAsString("tt", "");
+  if ((timers == 1) || (traceFnStr.size() > 0))
+    StageTimers::enable(traceFnStr.size() > 0);
 
   const float baseFreq = cliParser.getOptionAsFloat("bf", 12000.0);
   const int tonesSeparation = cliParser.getOptionAsInt("ts", 1);
@@ -223,8 +277,160 @@ int main(int argc, char** argv)
   const int synthMode = cliParser.getOptionAsInt("sm", 0);
   const float synthVolume = cliParser.getOptionAsFloat("sv", 0.0);
 
+  const int rawInput = cliParser.getOptionAsInt("ri", 0);
+  const int rawChannels = cliParser.getOptionAsInt("rc", 2);
+  const int rawOutput = cliParser.getOptionAsInt("ro", 0);
+
+  const int nativeEncoder = cliParser.getOptionAsInt("ne", 0);
+  const int synthCheck = cliParser.getOptionAsInt("sc", 0);
+
+  const int decodeMode = cliParser.getOptionAsInt("dc", 0);
+  const int decimate = cliParser.getOptionAsInt("dm", 0);
+  std::string watchListFnStr = cliParser.getOptionAsString("w", "");
+  std::string watchReportFnStr = cliParser.getOptionAsString("wr", "");
+  const int verify = cliParser.getOptionAsInt("vf", 0);
+
+  //stages publish their progress, the reporter thread writes it until main returns
+  MetricsReporter metricsReporter;
+  if ((metricsFnStr.size() > 0) && (metricsReporter.start(metricsFnStr.c_str(), metricsInterval) < 0))
+  {
+    std::cerr << "Cannot create metrics report " << metricsFnStr.c_str() << std::endl;
+    return -1;
+  }
+
+  if (decodeMode == 1) //DECODE MARKS FOUND IN INPUT AUDIO
+  {
+    if (inputFnStr.size() == 0)
+    {
+      std::cerr << "Decoding needs an input file. Please use the --file option" << std::endl;
+      return -1;
+    }
+
+    mBeepingCore = BEEPING_Create();
+
+    Scanner scanner(mBeepingCore);
+    scanner.setBufferSize(bufferSize);
+    scanner.setCustomBaseFreq(baseFreq, tonesSeparation);
+    scanner.setUseDecimator(decimate == 1);
+
+    std::vector<ScanDetection> detections;
+    if (scanner.scan(inputFnStr.c_str(), getBeepingMode(cliParser.getOptionAsInt("m", 2)), detections) < 0)
+    {
+      printf("%s is not a valid Wav File or file not found!\n", inputFnStr.c_str());
+      BEEPING_Destroy(mBeepingCore);
+      return -2;
+    }
+
+    for (int i = 0; i < (int)detections.size(); i++)
+    {
+      std::cout << "Decoded " << detections[i].time << " secs: " << detections[i].data
+                << ((detections[i].status > 0) ? " (ok)" : " (wrong)") << " confidence " << detections[i].confidence << std::endl;
+    }
+    std::cout << "Decoded marks: " << detections.size() << std::endl;
+
+    if (watchListFnStr.size() > 0)
+    {
+      WatchList watchList;
+      if (watchList.load(watchListFnStr.c_str()) < 0)
+      {
+        std::cerr << "Cannot read watch list " << watchListFnStr.c_str() << std::endl;
+        BEEPING_Destroy(mBeepingCore);
+        return -1;
+      }
+
+      for (int i = 0; i < (int)detections.size(); i++)
+      {
+        if ((detections[i].status > 0) && detections[i].hasPayload)
+          watchList.match(detections[i].payload, detections[i].time);
+      }
+
+      std::cout << "Watch list: " << watchList.getNumKeysHit() << " of " << watchList.getNumKeys() << " keys found" << std::endl;
+      if (watchList.writeReport(watchReportFnStr.c_str()) < 0)
+        std::cerr << "Cannot create watch list report " << watchReportFnStr.c_str() << std::endl;
+    }
+
+    if (verify == 1)
+    {
+      int32_t key = (keyStr.size() == Payload::kKeyChars) ? Payload::packKey(keyStr.c_str()) : -1;
+      if (key < 0)
+      {
+        std::cerr << "Verification needs a valid key. Please use the --key option" << std::endl;
+        BEEPING_Destroy(mBeepingCore);
+        return -1;
+      }
+
+      // codewords of the whole schedule, same mark times as the generator
+      std::vector<double> scheduleTimes;
+      std::vector<Payload> schedule;
+      for (double t = startTime; t - durToken*20.f < duration; t += interval)
+      {
+        scheduleTimes.push_back(t);
+        schedule.push_back(Payload((uint32_t)key, (uint32_t)(int)(t + 0.5f)));
+      }
+      MarkCode markCode;
+      std::vector<uint8_t> scheduleCodes(schedule.size() * MarkCode::kNumTokens);
+      markCode.encode(schedule.data(), (int)schedule.size(), scheduleCodes.data());
+
+      //BeepingCore hands out corrected characters only, decoded payloads are encoded again
+      //in one batch and their codewords are checked token by token against the schedule
+      std::vector<Payload> decoded;
+      std::vector<double> decodedTimes;
+      for (int i = 0; i < (int)detections.size(); i++)
+      {
+        if (!detections[i].hasPayload)
+          continue;
+        decoded.push_back(detections[i].payload);
+        decodedTimes.push_back(detections[i].time);
+      }
+      std::vector<uint8_t> decodedCodes(decoded.size() * MarkCode::kNumTokens);
+      markCode.encode(decoded.data(), (int)decoded.size(), decodedCodes.data());
+
+      std::vector<int> found(schedule.size(), 0);
+      const int decodedMarks = (int)decoded.size();
+      int verified = 0;
+      for (int i = 0; (i < decodedMarks) && !schedule.empty(); i++)
+      {
+        const double time = decodedTimes[i];
+        int n = 0; // nearest scheduled mark
+        for (int k = 1; k < (int)scheduleTimes.size(); k++)
+          if (fabs(scheduleTimes[k] - time) < fabs(scheduleTimes[n] - time))
+            n = k;
+
+        const uint8_t *code = &decodedCodes[(size_t)i * MarkCode::kNumTokens];
+        const uint8_t *expected = &scheduleCodes[(size_t)n * MarkCode::kNumTokens];
+        int tokens = 0; // tokens that differ
+        for (int k = 0; k < MarkCode::kNumTokens; k++)
+          tokens += (code[k] != expected[k]);
+
+        if (tokens == 0)
+        {
+          found[n] = 1;
+          verified++;
+        }
+        else
+        {
+          std::cout << "Verify " << time << " secs: differs from mark at " << scheduleTimes[n] << " secs in its"
+                    << ((decoded[i].getKey() != schedule[n].getKey()) ? " key" : "")
+                    << ((decoded[i].getTimestamp() != schedule[n].getTimestamp()) ? " timestamp" : "")
+                    << ", " << tokens << " of " << (int)MarkCode::kNumTokens << " tokens" << std::endl;
+        }
+      }
+
+      int missed = 0;
+      for (int n = 0; n < (int)found.size(); n++)
+        missed += (found[n] == 0);
+      std::cout << "Verified marks: " << verified << " of " << schedule.size() << " scheduled (" << missed << " missed, " << decodedMarks - verified << " unexpected)" << std::endl;
+    }
+
+    BEEPING_Destroy(mBeepingCore);
+
+    printTotalDuration(total_start, timers, traceFnStr);
+
+    return 0;
+  }
+
   //CHECK THAT PARAMETERS ARE CORRECT
-  if (keyStr.size() != 5)
+  if (keyStr.size() != Payload::kKeyChars)
   {
     std::cerr << "Wrong key. Please use a 5 characters only key" << std::endl;
     return -1;
@@ -233,13 +439,14 @@ int main(int argc, char** argv)
   {
     for (int i = 0; i < keyStr.size(); i++)
     {
-      if (charToVal(keyStr.c_str()[i]) == -1)
+      if (Payload::charToVal(keyStr.c_str()[i]) == -1)
       {
         std::cerr << "Wrong character in key [" << keyStr.c_str()[i] << "]. Please use digits in {0-9, a-v} range only" << std::endl;
         return -1;
       }
     }
   }
+  const uint32_t key = (uint32_t)Payload::packKey(keyStr.c_str());
 
   float min_startTime = (durToken*20.f) + 0.1f;
   float min_interval = (durToken*20.f) + 0.2f;
@@ -270,19 +477,45 @@ int main(int argc, char** argv)
     std::cerr << "Start time is not valid. It should be > " << min_startTime << " secs." << std::endl;
     return -1;
   }
+  if ((outputFormat < 0) || (outputFormat >= OutputFormat::kNumFormats))
+  {
+    std::cerr << "Output format is not valid. It should be 0 (wav 16 bits) to " << OutputFormat::kNumFormats - 1 << " (ogg vorbis)" << std::endl;
+    return -1;
+  }
+  if ((beepChannels < kBeepAllChannels) || (beepChannels > kBeepFrontLR))
+  {
+    std::cerr << "Beep channels are not valid. It should be 0 (all), 1 (center) or 2 (front left/right)" << std::endl;
+    return -1;
+  }
+  if ((limiter == 1) && ((limiterCeiling > 0.f) || (limiterCeiling < -20.f)))
+  {
+    std::cerr << "Limiter ceiling is not valid. It should be -20 to 0 dBTP" << std::endl;
+    return -1;
+  }
+  if ((noiseBed < 0) || (noiseBed > 3))
+  {
+    std::cerr << "Noise bed is not valid. It should be 0 (disabled), 1 (white), 2 (pink) or 3 (brown)" << std::endl;
+    return -1;
+  }
+  if ((generateChannels < 1) || (generateChannels > 8))
+  {
+    std::cerr << "Number of generated channels is not valid. It should be 1 to 8" << std::endl;
+    return -1;
+  }
+  if (useTimeline && ((timelineHop < 0.01f) || (timelineHop > 60.f)))
+  {
+    std::cerr << "Loudness timeline hop is not valid. It should be 0.01 to 60 seconds" << std::endl;
+    return -1;
+  }
+  if (useTimeline && (timelineFormat != LoudnessTimeline::kCsv) && (timelineFormat != LoudnessTimeline::kBinary))
+  {
+    std::cerr << "Loudness timeline format is not valid. It should be 0 (csv) or 1 (binary)" << std::endl;
+    return -1;
+  }
 
   startTime = MAX(startTime, min_startTime);
 
-  //enum BEEPING_MODE { BEEPING_MODE_AUDIBLEOLD = 0, BEEPING_MODE_NONAUDIBLEOLD = 1, BEEPING_MODE_AUDIBLE = 2, BEEPING_MODE_NONAUDIBLE = 3, BEEPING_MODE_HIDDEN = 4, BEEPING_MODE_ALL = 5, BEEPING_MODE_CUSTOM = 6 };
-  int mode = /*BEEPING_MODE::*/BEEPING_MODE_NONAUDIBLE; //2 audible, 3 non-audible
-  if (param_mode == 0)
-    mode = /*BEEPING_MODE::*/BEEPING_MODE_AUDIBLE;
-  else if (param_mode == 1)
-    mode = /*BEEPING_MODE::*/BEEPING_MODE_HIDDEN;
-  else if (param_mode == 2)
-    mode = /*BEEPING_MODE::*/BEEPING_MODE_NONAUDIBLE;
-  else if (param_mode == 3)
-    mode = /*BEEPING_MODE::*/BEEPING_MODE_CUSTOM;
+  int mode = getBeepingMode(param_mode);
 
 
   //Creation
@@ -298,6 +531,165 @@ int main(int argc, char** argv)
   BEEPING_SetSynthMode(synthMode, mBeepingCore);
   BEEPING_SetSynthVolume(synthVolume, mBeepingCore);
 
+  //the native encoder only renders tones, other synth modes go through BeepingCore
+  const bool useNativeEncoder = (nativeEncoder == 1) && (synthMode == 0);
+  ToneSynth toneSynth;
+
+  if (synthCheck == 1) //COMPARE NATIVE ENCODER WITH BEEPINGCORE
+  {
+    BEEPING_Configure(mode, sampleRate, bufferSize, mBeepingCore);
+    if (toneSynth.configure(mode, sampleRate, baseFreq, tonesSeparation) < 0)
+    {
+      std::cerr << "Native encoder does not support this mode" << std::endl;
+      BEEPING_Destroy(mBeepingCore);
+      return -1;
+    }
+
+    Payload payload(key, (int)(startTime + 0.5f));
+    CoreMarkEncoder coreEncoder(mBeepingCore, sampleRate, bufferSize, 0);
+    std::vector<float> coreMark(coreEncoder.getMaxMarkSamples());
+    std::vector<float> nativeMark(toneSynth.getMaxMarkSamples());
+
+    //every mark starts at phase 0 in both encoders
+    coreMark.resize(coreEncoder.render(payload, &coreMark[0], 1.f));
+    toneSynth.render(payload, &nativeMark[0], 1.f);
+
+    const int numRuns = 20;
+    std::vector<float> benchMark(MAX(coreEncoder.getMaxMarkSamples(), toneSynth.getMaxMarkSamples()));
+
+    clock_t start = clock();
+    for (int run = 0; run < numRuns; run++)
+      coreEncoder.render(payload, &benchMark[0], 1.f);
+    double coreTime = double(clock() - start) / (double)CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int run = 0; run < numRuns; run++)
+      toneSynth.render(payload, &benchMark[0], 1.f);
+    double nativeTime = double(clock() - start) / (double)CLOCKS_PER_SEC;
+
+    int n = MIN((int)coreMark.size(), (int)nativeMark.size());
+    double maxDiff = 0.0;
+    double sumDiff = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+      double d = fabs(coreMark[i] - nativeMark[i]);
+      maxDiff = MAX(maxDiff, d);
+      sumDiff += d * d;
+    }
+    double rmsDiff = (n > 0) ? sqrt(sumDiff / n) : 0.0;
+
+    std::cout << "Synth check: " << coreMark.size() << " samples BeepingCore, " << nativeMark.size() << " samples native" << std::endl;
+    std::cout << "Synth check: max difference " << maxDiff << ", rms difference " << rmsDiff << std::endl;
+    std::cout << "Synth check: BeepingCore " << 1000.0 * coreTime / numRuns << " ms/mark, native " << 1000.0 * nativeTime / numRuns << " ms/mark" << std::endl;
+
+    BEEPING_Destroy(mBeepingCore);
+    return (maxDiff < 1e-3) ? 0 : 1;
+  }
+
+  if (inputFnStr == "-") //STREAM FROM STDIN, MIX WITH BEEPS BLOCK BY BLOCK
+  {
+    if (outputFnStr == "-")
+      std::cout.rdbuf(std::cerr.rdbuf()); //stdout carries the audio, messages go to stderr
+
+    PcmStreamReader reader(0);
+    if (reader.open(rawInput == 1, rawChannels, (int)sampleRate) < 0)
+    {
+      std::cerr << "Input stream is not supported. Please use 16/24 bits or float PCM WAVE, or --rawinput 1" << std::endl;
+      BEEPING_Destroy(mBeepingCore);
+      return -2;
+    }
+
+    int nch = reader.getChannels();
+    float inputRate = (float)reader.getSampleRate();
+    float streamRate = getMarkingRate(inputRate);
+    Resampler rateCheck;
+    if ((inputRate != streamRate) && (rateCheck.configure(inputRate, streamRate) < 0))
+    {
+      std::cerr << "Input stream sample rate " << inputRate << " Hz cannot be converted to " << streamRate << " Hz" << std::endl;
+      BEEPING_Destroy(mBeepingCore);
+      return -2;
+    }
+
+    //marks are mixed at streamRate, the output goes back to the input rate if the beeps band survives it
+    BEEPING_Configure(mode, streamRate, bufferSize, mBeepingCore);
+    float outputRate = inputRate;
+    if ((inputRate != streamRate) && (BEEPING_GetDecodingEndFreq(mBeepingCore) >= Resampler::getPassband(streamRate, inputRate)))
+    {
+      std::cerr << "Beeps band ends at " << BEEPING_GetDecodingEndFreq(mBeepingCore) << " Hz, it does not fit in " << inputRate << " Hz audio. Output is written at " << streamRate << " Hz" << std::endl;
+      outputRate = streamRate;
+    }
+
+    //compressed formats need a seekable file, streams are written as PCM
+    int streamFormat = OutputFormat::toSampleFormat(outputFormat);
+    if ((streamFormat < 0) || ((rawOutput == 1) && (streamFormat != PcmConvert::kPcm16)))
+    {
+      std::cerr << "Streaming writes 16 bits PCM, " << OutputFormat::getName(outputFormat) << " is not supported" << std::endl;
+      streamFormat = PcmConvert::kPcm16;
+    }
+
+    int outputFd = (outputFnStr == "-") ? 1 : open(outputFnStr.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    PcmStreamWriter writer(outputFd);
+    if ((outputFd < 0) || (writer.open(rawOutput == 1, nch, (int)outputRate, streamFormat) < 0))
+    {
+      std::cerr << "Cannot create Output stream " << outputFnStr.c_str() << std::endl;
+      BEEPING_Destroy(mBeepingCore);
+      return -1;
+    }
+
+    CoreMarkEncoder coreEncoder(mBeepingCore, streamRate, bufferSize, synthMode);
+    MarkEncoder *markEncoder = &coreEncoder;
+    if (useNativeEncoder)
+    {
+      toneSynth.configure(mode, streamRate, baseFreq, tonesSeparation);
+      markEncoder = &toneSynth;
+    }
+    BeepTrack beepTrack(markEncoder, key, streamRate, bufferSize, startTime, interval, durToken*20.f);
+
+    //levels of the whole program are not known in advance, blocks are mixed with the default levels
+    if (mixmode != kDefaultMode)
+      std::cerr << "Streaming uses the default mixing mode (0)" << std::endl;
+    if (normalize == 1)
+      std::cerr << "Streaming does not normalize, the peak of the whole stream is not known. Use the limiter (--limiter 1)" << std::endl;
+    Mixer mixer;
+    mixer.setBeepLevel(volumebeeps);
+    mixer.setProgramLevel(volumeprogram);
+    mixer.setBeepPlacement(beepChannels);
+    mixer.setLimiter(limiter == 1, limiterCeiling);
+
+    //read, mix and write overlap on three threads
+    StreamPipeline pipeline(nch, inputRate, streamRate, outputRate);
+    LoudnessTimeline timeline;
+    if (useTimeline)
+    {
+      if (timeline.open(timelineFnStr.c_str(), nch, outputRate, timelineHop, timelineFormat) != LoudnessTimeline::kOk)
+      {
+        std::cerr << "Cannot create loudness timeline " << timelineFnStr.c_str() << std::endl;
+        BEEPING_Destroy(mBeepingCore);
+        return -1;
+      }
+      pipeline.setTimeline(&timeline);
+    }
+    Metrics::beginStage("stream", 0, outputRate);
+    if (pipeline.run(reader, writer, beepTrack, mixer) < 0)
+      std::cerr << "Cannot write Output stream" << std::endl;
+
+    std::cout << "Streamed " << beepTrack.getPosition() / streamRate << " secs" << std::endl;
+    if (useTimeline)
+      closeTimeline(timeline, timelineFnStr);
+
+    if (outputFd != 1)
+      close(outputFd);
+
+    BEEPING_Destroy(mBeepingCore);
+
+    printTotalDuration(total_start, timers, traceFnStr);
+
+    return 0;
+  }
+
+
+  //audio buffers of the job, all freed together when main returns
+  BufferPool bufferPool;
 
   //OUTPUT FILE
   SF_INFO sfinfoOutput;
@@ -309,39 +701,62 @@ int main(int argc, char** argv)
     //Configuration
     BEEPING_Configure(mode, sampleRate, bufferSize, mBeepingCore);
 
-    //CREATE OUTPUT AUDIO FILE
-    sfinfoOutput.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
-    sfinfoOutput.channels = 1; //or 2
-    sfinfoOutput.frames = 0;
-    sfinfoOutput.samplerate = (int)sampleRate;
-
-    pWaveFileOutput = sf_open(outputFnStr.c_str(), SFM_WRITE, &sfinfoOutput);
-    if (!pWaveFileOutput)
+    //CREATE OUTPUT AUDIO FILE, encoded on the writer thread
+    OutputWriter outputWriter;
+    outputWriter.setSync(syncOutput == 1);
+    if (outputWriter.open(outputFnStr.c_str(), generateChannels, (int)sampleRate, outputFormat) != OutputWriter::kOk)
     {
-      std::cerr << "Cannot create Output WaveFile " << outputFnStr.c_str() << std::endl;
+      std::cerr << "Cannot create Output " << OutputFormat::getName(outputFormat) << " file " << outputFnStr.c_str() << std::endl;
       return -1;
     }
+    LoudnessTimeline timeline;
+    if (useTimeline && (timeline.open(timelineFnStr.c_str(), generateChannels, sampleRate, timelineHop, timelineFormat) != LoudnessTimeline::kOk))
+    {
+      std::cerr << "Cannot create loudness timeline " << timelineFnStr.c_str() << std::endl;
+      return -1;
+    }
+    //running loudness of the output shown with the progress
+    LoudnessMeter meter;
+    if (loudnessStats == 1)
+      meter.configure(generateChannels, sampleRate);
 
     double currentTimeInSeconds = 0.0;
     double nextMarkTime = currentTimeInSeconds + startTime;
 
     float defBeepLevel = pow(10.f, volumebeeps / 20.f);
 
-    //PINK NOISE
-    //VRand rand;
-    //rand.seed();
-  //float w = rand.white(); // returns white noise +- 0.5
-    //float p = rand.pink();  // returns pink noise  +- 0.5
-  // float b = rand.brown(); // returns brown noise +- 0.5
+    //NOISE BED, one stream per channel so that the channels are not correlated. the noise
+    //of a frame only depends on the seed and its index, the same seed gives the same file
+    float noiseLevel = pow(10.f, noiseVolume / 20.f);
+    uint64_t noiseIndex = 0;
+    std::vector<VRandCounter> noise(generateChannels);
+    for (int t = 0; t < generateChannels; t++)
+      noise[t].setSeed((noiseSeed != 0) ? (uint64_t)noiseSeed : (uint64_t)time(NULL), t);
 
     //ENCODE *******************************************************
-    float *silenceBuffer = new float[bufferSize];
-    memset(silenceBuffer, 0, bufferSize * sizeof(float));
+    float *silenceBuffer = bufferPool.allocateZeroed(bufferSize * generateChannels);
 
-    float *audioBuffer = new float[bufferSize];
+    //int type = synthMode; //0 for only tones, 1 for tones + R2D2 sound, 2 for melody
+    CoreMarkEncoder coreEncoder(mBeepingCore, sampleRate, bufferSize, Globals::synthMode);
+    MarkEncoder *markEncoder = &coreEncoder;
+    if (useNativeEncoder)
+    {
+      toneSynth.configure(mode, sampleRate, baseFreq, tonesSeparation);
+      markEncoder = &toneSynth;
+    }
+    float *markBuffer = bufferPool.allocate(markEncoder->getMaxMarkSamples());
+
+    //marks are rendered once and spread to the placement channels
+    std::vector<float> beepGains;
+    Mixer::getBeepChannelGains(beepChannels, generateChannels, beepGains);
+    const bool useFrames = (generateChannels > 1) || (noiseBed > 0);
+    const int maxFrames = MAX(markEncoder->getMaxMarkSamples(), bufferSize);
+    float *markFrames = useFrames ? bufferPool.allocate(maxFrames * generateChannels) : markBuffer;
+    float *noiseBuffer = (noiseBed > 0) ? bufferPool.allocate(maxFrames) : NULL;
 
     int progress_beeps = 0;
     std::cout << "Progress BEEPS = " << progress_beeps << std::endl;
+    Metrics::beginStage("beeps", (long)(duration * sampleRate), sampleRate);
 
     while (currentTimeInSeconds < duration)
     {
@@ -350,80 +765,79 @@ int main(int argc, char** argv)
       {
         progress_beeps = current_progress_beeps;
         std::cout << "Progress BEEPS = " << progress_beeps << std::endl;
+        if (loudnessStats == 1)
+          std::cout << "Progress LUFS = " << meter.getGlobalLoudness() << std::endl;
       }
 
       if (currentTimeInSeconds >= (nextMarkTime - (durToken*20.f)))
       {
         int timestampInSeconds = (int)(nextMarkTime + 0.5f);
-        //char timestamp[33]; //itoa(timestampInSeconds,timestamp,32);
+        Payload payload(key, timestampInSeconds);
 
-        char* timestamp;
-        timestamp = fromDecToBase(timestampInSeconds, 32);
-
-        char currentTimestamp[5] = "\0";
-        int len = strlen(timestamp);
-        for (int i = len; i < 4; i++)
+        //beeps level is applied while rendering
+        int markSamples;
         {
-          strcat(currentTimestamp, "0");
+          ScopedTimer timer("encode");
+          markSamples = markEncoder->render(payload, markBuffer, defBeepLevel);
+          if (useFrames)
+            spreadToChannels(markBuffer, markSamples, generateChannels, beepGains, markFrames);
+          if (noiseBed > 0)
+            addNoiseBed(noise, noiseBed, noiseLevel, noiseIndex, noiseBuffer, markSamples, generateChannels, markFrames);
         }
-        strcat(currentTimestamp, timestamp);
-
-        //int num = fromBaseToDec(currentTimestamp, 4, 32);
-
-        char stringToDecode[10];
-        sprintf(stringToDecode, "%s%s", keyStr.c_str(), currentTimestamp);
-
-        int size = strlen(stringToDecode);
-        //int type = synthMode; //0 for only tones, 1 for tones + R2D2 sound, 2 for melody
-        int type = Globals::synthMode; //0 for only tones, 1 for tones + R2D2 sound, 2 for melody
-        int sizeAudioBuffer = BEEPING_EncodeDataToAudioBuffer(stringToDecode, size, type, 0, 0, mBeepingCore);
-
-        int samplesRetrieved = 0;
-
-        do
+        noiseIndex += markSamples;
+        Metrics::setFrames((long)noiseIndex);
         {
-          memset(audioBuffer, 0, bufferSize * sizeof(float));
-          samplesRetrieved = BEEPING_GetEncodedAudioBuffer(audioBuffer, mBeepingCore);
-
-          //mix with pink noise
-          /*for (int i=0;i<bufferSize;i++)
-          {
-            //audioBuffer[i] = rand.pink();
-            audioBuffer[i] = rand.brown();
-          }*/
-
-          //adjust volume of beeps based on parameter volumebeeps
-          for (int i = 0; i < bufferSize; i++)
-          {
-            audioBuffer[i] = defBeepLevel * audioBuffer[i];
-          }
-
-          int count = (int)sf_write_float(pWaveFileOutput, audioBuffer, samplesRetrieved);
-
-          currentTimeInSeconds = currentTimeInSeconds + (double)samplesRetrieved / sampleRate;
-          //currentTimeInSeconds = currentTimeInSeconds + bufferSize/sampleRate;
-        } while (samplesRetrieved > 0);
-
-        //add silence at the end of file
-        //memset(silenceBuffer,0,silenceSize*sizeof(float));
-        //sf_write_float(pWaveFileOutput, silenceBuffer, silenceSize);
-
-        BEEPING_ResetEncodedAudioBuffer(mBeepingCore);
+          ScopedTimer timer("write");
+          outputWriter.write(markFrames, markSamples);
+        }
+        {
+          ScopedTimer timer("loudness");
+          timeline.add(markFrames, markSamples);
+          meter.add(markFrames, markSamples);
+        }
+        currentTimeInSeconds = currentTimeInSeconds + (double)markSamples / sampleRate;
 
         nextMarkTime += interval;
       }
       else
       {
-        //add silence between marks
-        sf_write_float(pWaveFileOutput, silenceBuffer, bufferSize);
+        //add silence (or the noise bed alone) between marks
+        if (noiseBed > 0)
+        {
+          {
+            ScopedTimer timer("encode");
+            memset(markFrames, 0, bufferSize * generateChannels * sizeof(float));
+            addNoiseBed(noise, noiseBed, noiseLevel, noiseIndex, noiseBuffer, bufferSize, generateChannels, markFrames);
+          }
+          ScopedTimer timer("write");
+          outputWriter.write(markFrames, bufferSize);
+        }
+        else
+        {
+          ScopedTimer timer("write");
+          outputWriter.write(silenceBuffer, bufferSize);
+        }
+        {
+          const float *written = (noiseBed > 0) ? markFrames : silenceBuffer;
+          ScopedTimer timer("loudness");
+          timeline.add(written, bufferSize);
+          meter.add(written, bufferSize);
+        }
+        noiseIndex += bufferSize;
+        Metrics::setFrames((long)noiseIndex);
         currentTimeInSeconds = currentTimeInSeconds + bufferSize / sampleRate;
       }
     }
 
-    delete[] silenceBuffer;
-    delete[] audioBuffer;
+    if (outputWriter.close() != OutputWriter::kOk)
+    {
+      std::cerr << "Cannot write Output file " << outputFnStr.c_str() << std::endl;
+      return -4;
+    }
 
     std::cout << "Progress BEEPS = " << 100 << std::endl;
+    if (useTimeline)
+      closeTimeline(timeline, timelineFnStr);
   }
   else //MIX WITH INPUT AUDIO
   {
@@ -432,6 +846,9 @@ int main(int argc, char** argv)
     SF_INFO sfinfoInput;
     memset(&sfinfoInput, '\0', sizeof(sfinfoInput));
     float **ppInputBuffer = NULL;
+    //peaks for the deferred normalization of the blocks, measured while they are in cache
+    float programPeak = 0.f;
+    float beepsPeak = 0.f;
 
     pWaveFileInput = sf_open(inputFnStr.c_str(), SFM_READ, &sfinfoInput);
 
@@ -439,16 +856,22 @@ int main(int argc, char** argv)
     int nch;
     float sampleRate;
     int buffersamples = 4096;
+    //rate and length of the input, marks are mixed at sampleRate
+    float inputRate;
+    long inputFrames;
 
     if (pWaveFileInput) // read Input File to buffer
     {
       nFrames = sfinfoInput.frames;
       nch = (int)sfinfoInput.channels;
-      sampleRate = (float)sfinfoInput.samplerate;
+      inputRate = (float)sfinfoInput.samplerate;
+      inputFrames = nFrames;
+      sampleRate = getMarkingRate(inputRate);
 
-      if ((sampleRate != 44100.f) && (sampleRate != 48000.f))
+      Resampler rateCheck;
+      if ((inputRate != sampleRate) && (rateCheck.configure(inputRate, sampleRate) < 0))
       {
-        printf("%s is not a valid Wav File! Please use 44.1Khz or 48Khz 16bits PCM Wave File\n", inputFnStr.c_str());
+        printf("%s is not a valid Wav File! Sampling rate %g Hz cannot be converted to %g Hz\n", inputFnStr.c_str(), inputRate, sampleRate);
         sf_close(pWaveFileInput);
         return -2;
       }
@@ -471,38 +894,69 @@ int main(int argc, char** argv)
 
 
       //float *pInputBufferInterleaved = new float[nFrames*nch];
-      float *pInputBufferInterleaved = new float[buffersamples*nch];
+      float *pInputBufferInterleaved = bufferPool.allocate(buffersamples*nch);
+
+      ppInputBuffer = bufferPool.allocatePlanar(nch, nFrames);
+      if (!ppInputBuffer)
+      {
+        printf("%s is too long, not enough memory to load it\n", inputFnStr.c_str());
+        sf_close(pWaveFileInput);
+        return -3;
+      }
 
-      ppInputBuffer = new float*[nch];
-      for (int i = 0; i < nch; i++)
-        ppInputBuffer[i] = new float[nFrames];
+      //plain PCM input is converted straight from a memory map
+      MappedWavReader mappedInput;
+      bool useMappedInput = (mappedInput.open(inputFnStr.c_str()) == MappedWav::kOk) && (mappedInput.getFrames() == nFrames) && (mappedInput.getChannels() == nch);
 
-      int readsamples = 0;
-      while (readsamples < nFrames*nch)
+      long readFrames = 0;
+      Metrics::beginStage("read", nFrames, inputRate);
+      while (readFrames < nFrames)
       {
-        //int ReadCount = (int)sf_read_float(pWaveFileInput, pInputBufferInterleaved, nFrames*nch);
-        int ReadCount = (int)sf_read_float(pWaveFileInput, pInputBufferInterleaved, buffersamples*nch);
+        int framesToRead = (int)MIN((long)buffersamples, nFrames - readFrames);
+        //mono frames are already planar and are read straight into the channel buffer
+        float *pRead = (nch == 1) ? ppInputBuffer[0] + readFrames : pInputBufferInterleaved;
+        int ReadCount;
+        {
+          ScopedTimer timer("read");
+          ReadCount = useMappedInput ? mappedInput.read(pRead, framesToRead) : (int)sf_readf_float(pWaveFileInput, pRead, framesToRead);
+        }
+        if (ReadCount <= 0)
+          break;
 
         //Copy from interleaved to buffers
-        for (int t = 0; t < nch; t++)
+        if (nch > 1)
         {
-          for (int i = 0; i < (ReadCount/nch); i++)
-          {
-            ppInputBuffer[t][(readsamples/nch)+i] = pInputBufferInterleaved[i*nch + t];
-          }
+          ScopedTimer timer("deinterleave");
+          PlanarIO::deinterleave(pInputBufferInterleaved, ReadCount, nch, ppInputBuffer, readFrames);
         }
+        if (normalize == 1)
+          programPeak = getPeak(pRead, (long)ReadCount * nch, programPeak);
 
-        readsamples += ReadCount;
+        readFrames += ReadCount;
+        Metrics::setFrames(readFrames);
       }
+      for (int t = 0; t < nch; t++) //truncated file
+        memset(ppInputBuffer[t] + readFrames, 0, (nFrames - readFrames) * sizeof(float));
 
-      //Delete interleaved
-      delete[] pInputBufferInterleaved;
       sf_close(pWaveFileInput);
 
+      if (inputRate != sampleRate) //CONVERT TO THE MARKING RATE
+      {
+        std::cout << "Converting " << inputRate << " Hz input to " << sampleRate << " Hz" << std::endl;
+        Metrics::beginStage("resample", 0, inputRate);
+        nFrames = rateCheck.getOutputLength(inputFrames);
+        ScopedTimer timer("resample");
+        ppInputBuffer = resamplePlanar(bufferPool, ppInputBuffer, nch, inputFrames, inputRate, sampleRate, nFrames);
+        if (!ppInputBuffer)
+        {
+          printf("%s is too long, not enough memory to convert it\n", inputFnStr.c_str());
+          return -3;
+        }
+      }
     }
     else
     {
-      printf("%s is not a valid Wav File or file not found! Please use 44.1Khz or 48Khz 16bits PCM Wave File\n", inputFnStr.c_str());
+      printf("%s is not a valid Wav File or file not found!\n", inputFnStr.c_str());
       return -2;
     }
 
@@ -511,10 +965,24 @@ int main(int argc, char** argv)
     int progress_beeps = 0;
     std::cout << "Progress BEEPS = " << progress_beeps << std::endl;
 
-    float *pBeepsBuffer = new float[nFrames + (int)((durToken*20.f)*sampleRate)]; //added duration of one beep message just to avoid buffer overflow when beep starts at the end of file (not sure it is needed though)
+    CoreMarkEncoder coreEncoder(mBeepingCore, sampleRate, bufferSize, synthMode);
+    MarkEncoder *markEncoder = &coreEncoder;
+    if (useNativeEncoder)
+    {
+      toneSynth.configure(mode, sampleRate, baseFreq, tonesSeparation);
+      markEncoder = &toneSynth;
+    }
+
+    float *pBeepsBuffer = bufferPool.allocate(nFrames + markEncoder->getMaxMarkSamples()); //added duration of one beep message to avoid buffer overflow when beep starts at the end of file
+    if (!pBeepsBuffer)
+    {
+      printf("%s is too long, not enough memory to mix it\n", inputFnStr.c_str());
+      return -3;
+    }
     memset(pBeepsBuffer, 0, nFrames*sizeof(float));
 
     long counterSamples = 0;
+    Metrics::beginStage("beeps", nFrames, sampleRate);
     double currentTimeInSeconds = 0.0;
     double nextMarkTime = currentTimeInSeconds + startTime;
     float input_duration = nFrames / sampleRate;
@@ -530,55 +998,16 @@ int main(int argc, char** argv)
       if (currentTimeInSeconds >= (nextMarkTime - (durToken*20.f)))
       {
         int timestampInSeconds = (int)(nextMarkTime + 0.5f);
-        //char timestamp[33]; //itoa(timestampInSeconds,timestamp,32);
+        Payload payload(key, timestampInSeconds);
 
-        char* timestamp;
-        timestamp = fromDecToBase(timestampInSeconds, 32);
-
-        char currentTimestamp[5] = "\0";
-        int len = strlen(timestamp);
-        for (int i = len; i < 4; i++)
-        {
-          strcat(currentTimestamp, "0");
-        }
-        strcat(currentTimestamp, timestamp);
-
-        //int num = fromBaseToDec(currentTimestamp, 4, 32);
-
-        char stringToDecode[10];
-        sprintf(stringToDecode, "%s%s", keyStr.c_str(), currentTimestamp);
-
-        int size = strlen(stringToDecode);
-        int type = synthMode; //0 for only tones, 1 for tones + R2D2 sound, 2 for melody
-        int sizeAudioBuffer = BEEPING_EncodeDataToAudioBuffer(stringToDecode, size, type, 0, 0, mBeepingCore);
-
-        int samplesRetrieved = 0;
-
-        do
-        {
-          //memset(audioBuffer, 0, bufferSize * sizeof(float));
-          samplesRetrieved = BEEPING_GetEncodedAudioBuffer(pBeepsBuffer+counterSamples, mBeepingCore);
-
-          counterSamples += samplesRetrieved;
-
-          //mix with pink noise
-          /*for (int i=0;i<bufferSize;i++)
-          {
-          //audioBuffer[i] = rand.pink();
-          audioBuffer[i] = rand.brown();
-          }*/
-
-          //int count = (int)sf_write_float(pWaveFileOutput, audioBuffer, samplesRetrieved);
-
-          currentTimeInSeconds = currentTimeInSeconds + (double)samplesRetrieved / sampleRate;
-          //currentTimeInSeconds = currentTimeInSeconds + bufferSize/sampleRate;
-        } while (samplesRetrieved > 0);
-
-        //add silence at the end of file
-        //memset(silenceBuffer,0,silenceSize*sizeof(float));
-        //sf_write_float(pWaveFileOutput, silenceBuffer, silenceSize);
-
-        BEEPING_ResetEncodedAudioBuffer(mBeepingCore);
+        //rendered in place in the beeps track
+        ScopedTimer timer("encode");
+        int markSamples = markEncoder->render(payload, pBeepsBuffer + counterSamples, 1.f);
+        if (normalize == 1)
+          beepsPeak = getPeak(pBeepsBuffer + counterSamples, markSamples, beepsPeak);
+        counterSamples += markSamples;
+        Metrics::setFrames(counterSamples);
+        currentTimeInSeconds = currentTimeInSeconds + (double)markSamples / sampleRate;
 
         nextMarkTime += interval;
       }
@@ -587,6 +1016,7 @@ int main(int argc, char** argv)
         //add silence between marks
         //sf_write_float(pWaveFileOutput, silenceBuffer, bufferSize);
         counterSamples += bufferSize;
+        Metrics::setFrames(counterSamples);
         currentTimeInSeconds = currentTimeInSeconds + bufferSize / sampleRate;
       }
     }
@@ -600,62 +1030,105 @@ int main(int argc, char** argv)
     mixer.setProgramLevel(volumeprogram);
     //mixer.setSmoothTime(float time);
     mixer.setMode(mixmode);
-    mixer.setUseNormalize(false);
-
-    float **ppMixedBuffer = new float*[nch];
-    for (int i = 0; i < nch; i++)
-      ppMixedBuffer[i] = new float[nFrames];
-
-    //mixer.mix(const float** bufferPgm, const int nsamples, int nchannels, const float samplerate, const float* bufferBeeps, float** bufferMix);
-    mixer.mix((const float**)ppInputBuffer, nFrames, nch, sampleRate, pBeepsBuffer, ppMixedBuffer);
+    mixer.setUseNormalize(normalize == 1);
+    mixer.setBeepPlacement(beepChannels);
+    mixer.setLimiter(limiter == 1, limiterCeiling);
+
+    //mixed in place over the program buffers
+    float **ppMixedBuffer = ppInputBuffer;
+    ppInputBuffer = NULL;
+
+    //default levels do not depend on the whole program, blocks are then mixed just before
+    //being queued so mixing overlaps the encoding of the previous blocks (the limiter
+    //output lags the blocks, it runs within the whole buffer mix)
+    const bool mixBlocks = (mixmode == kDefaultMode) && (inputRate == sampleRate) && (limiter != 1);
+    if (!mixBlocks)
+    {
+      //mixer.mix(const float** bufferPgm, const int nsamples, int nchannels, const float samplerate, const float* bufferBeeps, float** bufferMix);
+      mixer.mix((const float**)ppMixedBuffer, nFrames, nch, sampleRate, pBeepsBuffer, ppMixedBuffer);
+    }
+    else
+      std::cout << "Progress MIX = " << 0 << std::endl;
 
-    //Bypass
-    /*for (int t=0;t<nch;t++)
+    if (inputRate != sampleRate) //CONVERT BACK TO THE INPUT RATE
     {
-      for (int i = 0; i < nFrames; i++)
+      //the marks must fit below the passband of the conversion, otherwise the output stays at the marking rate
+      float bandEnd = BEEPING_GetDecodingEndFreq(mBeepingCore);
+      if (bandEnd < Resampler::getPassband(sampleRate, inputRate))
       {
-        ppMixedBuffer[t][i] = (ppInputBuffer[t][i]+pBeepsBuffer[i]);
+        std::cout << "Converting " << sampleRate << " Hz mix back to " << inputRate << " Hz" << std::endl;
+        Metrics::beginStage("resample", 0, sampleRate);
+        ScopedTimer timer("resample");
+        ppMixedBuffer = resamplePlanar(bufferPool, ppMixedBuffer, nch, nFrames, sampleRate, inputRate, inputFrames);
+        if (!ppMixedBuffer)
+        {
+          printf("%s is too long, not enough memory to convert it\n", inputFnStr.c_str());
+          return -3;
+        }
+        nFrames = inputFrames;
+        sampleRate = inputRate;
       }
-    }*/
-    delete[] pBeepsBuffer;
+      else
+        std::cout << "Beeps band ends at " << bandEnd << " Hz, it does not fit in " << inputRate << " Hz audio. Output is written at " << sampleRate << " Hz" << std::endl;
+    }
 
     //WRITE MIXED AUDIO TO OUTPUT FILE
     int progress_save = 0;
     std::cout << "Progress SAVE = " << progress_save << std::endl;
-    sfinfoInput.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
-    pWaveFileOutput = sf_open(outputFnStr.c_str(), SFM_WRITE, &sfinfoInput);
-    if (!pWaveFileOutput)
+    //the output was opened before reading to check that it can be created, reopen it with the input layout
+    sf_close(pWaveFileOutput);
+    pWaveFileOutput = NULL;
+
+    //plain PCM WAV is written through a memory map, compressed formats (and WAV files that
+    //cannot be mapped or reserved on the disk) are encoded by libsndfile on the writer thread
+    MappedWavWriter mappedOutput;
+    OutputWriter outputWriter;
+    mappedOutput.setSync(syncOutput == 1);
+    outputWriter.setSync(syncOutput == 1);
+    const int sampleFormat = OutputFormat::toSampleFormat(outputFormat);
+    bool useMappedOutput = (sampleFormat >= 0) && (mappedOutput.create(outputFnStr.c_str(), nch, (int)sampleRate, nFrames, sampleFormat) == MappedWav::kOk);
+    if (!useMappedOutput && (outputWriter.open(outputFnStr.c_str(), nch, (int)sampleRate, outputFormat) != OutputWriter::kOk))
+    {
+      printf("Cannot create Output %s file %s!\n", OutputFormat::getName(outputFormat), outputFnStr.c_str());
+
+      return -4;
+    }
+    else
     {
-      if (ppInputBuffer)
+      LoudnessTimeline timeline;
+      if (useTimeline && (timeline.open(timelineFnStr.c_str(), nch, sampleRate, timelineHop, timelineFormat) != LoudnessTimeline::kOk))
       {
-        for (int i = 0; i < nch; i++)
-        {
-          delete[] ppInputBuffer[i];
-        }
-        delete[] ppInputBuffer;
+        printf("Cannot create loudness timeline %s!\n", timelineFnStr.c_str());
+        return -4;
       }
-      ppInputBuffer = NULL;
-
-      if (ppMixedBuffer)
+      //running loudness of the output shown with the progress
+      LoudnessMeter meter;
+      if (loudnessStats == 1)
+        meter.configure(nch, sampleRate);
+
+      //normalization is applied while the samples are converted for the output, blocks mixed
+      //in the write loop use the bound given by the program and beeps peaks
+      if (normalize == 1)
       {
-        for (int i = 0; i < nch; i++)
+        float outputGain = mixer.getOutputGain();
+        if (mixBlocks)
         {
-          delete[] ppMixedBuffer[i];
+          float peakBound = mixer.getBlockPeakBound(programPeak, beepsPeak);
+          outputGain = (peakBound > 0.f) ? 1.f / peakBound : 1.f;
         }
-        delete[] ppMixedBuffer;
+        std::cout << "Normalize gain = " << 20.f * log10f(outputGain) << " dB" << std::endl;
+        mappedOutput.setGain(outputGain);
+        outputWriter.setGain(outputGain);
+        timeline.setGain(outputGain);
+        meter.setGain(outputGain);
       }
-      ppMixedBuffer = NULL;
-
-      printf("Cannot create Output WaveFile %s!\n", outputFnStr.c_str());
 
-      return -4;
-    }
-    else
-    {
       int buffersamples = 4096;
-      float *pOutputBufferInterleaved = new float[buffersamples*nch];
+      float *pOutputBufferInterleaved = bufferPool.allocate(buffersamples*nch);
+      float **ppBlock = bufferPool.allocateChannels(nch);
 
       int samplesread = 0;
+      Metrics::beginStage("save", nFrames, sampleRate);
 
       while (samplesread < nFrames)
       {
@@ -664,37 +1137,60 @@ int main(int argc, char** argv)
         {
           progress_save = current_progress_save;
           std::cout << "Progress SAVE = " << progress_save << std::endl;
+          if (loudnessStats == 1)
+            std::cout << "Progress LUFS = " << meter.getGlobalLoudness() << std::endl;
         }
 
         int samplesToWrite = MIN(buffersamples, nFrames - samplesread);
 
-        for (int t = 0; t < nch; t++)
+        if (mixBlocks)
+        {
+          for (int t = 0; t < nch; t++)
+            ppBlock[t] = ppMixedBuffer[t] + samplesread;
+          ScopedTimer timer("mix");
+          mixer.mixBlock((const float**)ppBlock, samplesToWrite, nch, pBeepsBuffer + samplesread, ppBlock);
+        }
+
+        if (useMappedOutput)
         {
-          for (int i = 0; i < samplesToWrite; i++)
           {
-            pOutputBufferInterleaved[i*nch + t] = ppMixedBuffer[t][samplesread+i];
+            ScopedTimer timer("interleave");
+            PlanarIO::interleave((const float* const*)ppMixedBuffer, samplesread, samplesToWrite, nch, pOutputBufferInterleaved);
           }
+          {
+            ScopedTimer timer("write");
+            mappedOutput.write(pOutputBufferInterleaved, samplesToWrite);
+          }
+          ScopedTimer timer("loudness");
+          timeline.add(pOutputBufferInterleaved, samplesToWrite);
+          meter.add(pOutputBufferInterleaved, samplesToWrite);
+        }
+        else
+        {
+          {
+            ScopedTimer timer("interleave"); //the writer thread encodes, see its "write"
+            outputWriter.writePlanar((const float* const*)ppMixedBuffer, samplesread, samplesToWrite);
+          }
+          ScopedTimer timer("loudness");
+          timeline.addPlanar((const float* const*)ppMixedBuffer, samplesread, samplesToWrite);
+          meter.addPlanar((const float* const*)ppMixedBuffer, samplesread, samplesToWrite);
         }
-
-        int count = (int)sf_write_float(pWaveFileOutput, pOutputBufferInterleaved, samplesToWrite*nch);
 
         samplesread += samplesToWrite;
+        Metrics::setFrames(samplesread);
       }
 
-      delete[] pOutputBufferInterleaved;
+      if (mixBlocks)
+        std::cout << "Progress MIX = " << 100 << std::endl;
 
-      if (ppMixedBuffer)
+      const bool mappedError = (mappedOutput.close() != MappedWav::kOk);
+      if ((outputWriter.close() != OutputWriter::kOk) || mappedError) //waits for the queued blocks to be encoded
       {
-        for (int i = 0; i < nch; i++)
-        {
-          delete[] ppMixedBuffer[i];
-        }
-        delete[] ppMixedBuffer;
+        printf("Cannot write Output file %s!\n", outputFnStr.c_str());
+        return -4;
       }
-      ppMixedBuffer = NULL;
-
-      sf_close(pWaveFileOutput);
-
+      if (useTimeline)
+        closeTimeline(timeline, timelineFnStr);
     }
 
     std::cout << "Progress SAVE = " << 100 << std::endl;
@@ -706,7 +1202,9 @@ int main(int argc, char** argv)
   if (loudnessStats == 1)
   {
     std::cout << "STATISTICS: " << std::endl;
+    Metrics::beginStage("loudness", 0, sampleRate);
 
+    ScopedTimer timer("loudness");
     double lufs = test_global_loudness(outputFnStr.c_str());
     std::cout << " Lufs:      " << lufs << " dB" << std::endl;
 
@@ -724,9 +1222,7 @@ int main(int argc, char** argv)
 
   sf_close(pWaveFileOutput);
 
-  total_end = clock();
-  double totalDuration = double(total_end - total_start) / (double)CLOCKS_PER_SEC;
-  std::cout << "Total Duration: " << totalDuration << " secs" << std::endl;
+  printTotalDuration(total_start, timers, traceFnStr);
 
   return 0;
 }
@@ -0,0 +1,69 @@
+/*--------------------------------------------------------------------------------
+ BeepTrack.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "BeepTrack.h"
+
+#include <string.h>
+
+BeepTrack::BeepTrack(MarkEncoder *encoder, uint32_t key, float sampleRate, int bufferSize, double startTime, double interval, double markDuration)
+{
+  mEncoder = encoder;
+  mKey = key;
+  mSampleRate = sampleRate;
+  mBufferSize = bufferSize;
+  mInterval = interval;
+  mMarkDuration = markDuration;
+
+  mPosition = 0;
+  mCursor = 0;
+  mCursorTime = 0.0;
+  mNextMarkTime = startTime;
+
+  mMark = new float[encoder->getMaxMarkSamples()];
+  mMarkStart = 0;
+  mMarkSamples = 0;
+}
+
+BeepTrack::~BeepTrack()
+{
+  delete[] mMark;
+}
+
+void BeepTrack::render(float *out, int nframes, float gain)
+{
+  memset(out, 0, nframes * sizeof(float));
+  const long end = mPosition + nframes;
+
+  while (true)
+  {
+    // part of the current mark inside the block
+    long from = (mMarkStart > mPosition) ? mMarkStart : mPosition;
+    long to = (mMarkStart + mMarkSamples < end) ? mMarkStart + mMarkSamples : end;
+    for (long i = from; i < to; i++)
+      out[i - mPosition] = gain * mMark[i - mMarkStart];
+
+    if (mCursor >= end)
+      break;
+
+    // one more schedule step
+    if (mCursorTime >= (mNextMarkTime - mMarkDuration))
+    {
+      Payload payload(mKey, (int)(mNextMarkTime + 0.5f));
+      mMarkSamples = mEncoder->render(payload, mMark, 1.f);
+      mMarkStart = mCursor;
+      mCursor += mMarkSamples;
+      mCursorTime += (double)mMarkSamples / mSampleRate;
+      mNextMarkTime += mInterval;
+    }
+    else
+    {
+      mCursor += mBufferSize;
+      mCursorTime += mBufferSize / mSampleRate;
+    }
+  }
+
+  mPosition = end;
+}
@@ -0,0 +1,48 @@
+/*--------------------------------------------------------------------------------
+ BeepTrack.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef BeepTrack_h
+#define BeepTrack_h
+
+#include <stdint.h>
+
+#include "MarkEncoder.h"
+
+// Beeps track rendered block by block for streams of unknown length.
+//
+// Marks follow the same schedule as the file based modes: the schedule advances in
+// bufferSize steps of silence and a mark starts at the first step past
+// (nextMarkTime - markDuration), nextMarkTime being startTime, startTime + interval...
+// The mark encodes the key and nextMarkTime rounded to seconds.
+class BeepTrack{
+public:
+  BeepTrack(MarkEncoder *encoder, uint32_t key, float sampleRate, int bufferSize, double startTime, double interval, double markDuration);
+  ~BeepTrack();
+
+  // writes the beeps of the next nframes frames, scaled by gain
+  void render(float *out, int nframes, float gain);
+
+  long getPosition() { return mPosition; };
+
+private:
+  MarkEncoder *mEncoder;
+  uint32_t mKey;
+  float mSampleRate;
+  int mBufferSize;
+  double mInterval;
+  double mMarkDuration;
+
+  long mPosition;        // first frame of the next block
+  long mCursor;          // schedule position in frames
+  double mCursorTime;    // schedule position in seconds, advanced like the file based loops
+  double mNextMarkTime;
+
+  float *mMark;          // last rendered mark
+  long mMarkStart;
+  int mMarkSamples;
+};
+
+#endif /* BeepTrack_h */
@@ -0,0 +1,104 @@
+/*--------------------------------------------------------------------------------
+ BufferPool.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "BufferPool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static inline size_t alignUp(size_t size)
+{
+  return (size + BufferPool::kAlignment - 1) & ~(size_t)(BufferPool::kAlignment - 1);
+}
+
+BufferPool::BufferPool(size_t chunkBytes)
+{
+  mChunkBytes = alignUp(chunkBytes);
+  mCursor = NULL;
+  mEnd = NULL;
+  mBytesUsed = 0;
+  mBytesReserved = 0;
+}
+
+BufferPool::~BufferPool()
+{
+  release();
+}
+
+void *BufferPool::allocateBytes(size_t size)
+{
+  size = alignUp(size > 0 ? size : 1);
+
+  if (size > mChunkBytes / 2) // dedicated chunk, the current one stays open
+  {
+    void *chunk = NULL;
+    if (posix_memalign(&chunk, kAlignment, size) != 0)
+      return NULL;
+    mChunks.push_back(chunk);
+    mBytesReserved += size;
+    mBytesUsed += size;
+    return chunk;
+  }
+
+  if ((size_t)(mEnd - mCursor) < size)
+  {
+    void *chunk = NULL;
+    if (posix_memalign(&chunk, kAlignment, mChunkBytes) != 0)
+      return NULL;
+    mChunks.push_back(chunk);
+    mBytesReserved += mChunkBytes;
+    mCursor = (char*)chunk;
+    mEnd = mCursor + mChunkBytes;
+  }
+
+  void *p = mCursor;
+  mCursor += size;
+  mBytesUsed += size;
+  return p;
+}
+
+float *BufferPool::allocate(size_t count)
+{
+  return (float*)allocateBytes(count * sizeof(float));
+}
+
+float *BufferPool::allocateZeroed(size_t count)
+{
+  float *p = allocate(count);
+  if (p)
+    memset(p, 0, count * sizeof(float));
+  return p;
+}
+
+float **BufferPool::allocateChannels(int nchannels)
+{
+  return (float**)allocateBytes(nchannels * sizeof(float*));
+}
+
+float **BufferPool::allocatePlanar(int nchannels, size_t nframes)
+{
+  float **channels = allocateChannels(nchannels);
+  if (!channels)
+    return NULL;
+  for (int t = 0; t < nchannels; t++)
+  {
+    channels[t] = allocate(nframes);
+    if (!channels[t])
+      return NULL;
+  }
+  return channels;
+}
+
+void BufferPool::release()
+{
+  for (int i = 0; i < (int)mChunks.size(); i++)
+    free(mChunks[i]);
+  mChunks.clear();
+  mCursor = NULL;
+  mEnd = NULL;
+  mBytesUsed = 0;
+  mBytesReserved = 0;
+}
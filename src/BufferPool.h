@@ -0,0 +1,54 @@
+/*--------------------------------------------------------------------------------
+ BufferPool.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef BufferPool_h
+#define BufferPool_h
+
+#include <stddef.h>
+#include <vector>
+
+// Run-scoped arena for the audio buffers of one job.
+//
+// Buffers are carved out of large chunks with a bump pointer and are never freed one by
+// one: everything goes away with release() or the destructor at the end of the job. Each
+// buffer starts on a kAlignment boundary for the SIMD kernels. Requests bigger than half
+// a chunk (whole program buffers) get a chunk of their own, so small buffers do not waste
+// the tail of a big one.
+class BufferPool{
+public:
+  enum { kAlignment = 64 };
+
+  BufferPool(size_t chunkBytes = 1 << 20);
+  ~BufferPool();
+
+  // count floats, not initialized. returns NULL if memory is exhausted
+  float *allocate(size_t count);
+  // count floats set to zero
+  float *allocateZeroed(size_t count);
+  // array of nchannels channel pointers, not initialized
+  float **allocateChannels(int nchannels);
+  // nchannels buffers of nframes floats, the channel array lives in the pool too
+  float **allocatePlanar(int nchannels, size_t nframes);
+
+  // frees every buffer handed out so far
+  void release();
+
+  size_t getBytesUsed() { return mBytesUsed; };
+  size_t getBytesReserved() { return mBytesReserved; };
+  int getNumChunks() { return (int)mChunks.size(); };
+
+private:
+  void *allocateBytes(size_t size);
+
+  size_t mChunkBytes;
+  std::vector<void*> mChunks;
+  char *mCursor;           // next free byte of the current chunk
+  char *mEnd;
+  size_t mBytesUsed;
+  size_t mBytesReserved;
+};
+
+#endif /* BufferPool_h */
@@ -0,0 +1,177 @@
+/*--------------------------------------------------------------------------------
+ Decimator.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "Decimator.h"
+
+#include <math.h>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846264338327950288
+#endif
+
+static long gcdLong(long a, long b)
+{
+  while (b != 0)
+  {
+    long t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+Decimator::Decimator()
+{
+  mInRate = 44100.f;
+  mOutRate = 11025.f;
+  mCenterFreq = 0.f;
+  mIfFreq = 0.f;
+  mUp = 1;
+  mDown = 1;
+  mTapsPerPhase = 0;
+  mHistPos = 0;
+  mPhase = 0;
+  mWait = 0;
+  mDownRe = 1.0; mDownIm = 0.0; mDownStepRe = 1.0; mDownStepIm = 0.0;
+  mUpRe = 1.0; mUpIm = 0.0; mUpStepRe = 1.0; mUpStepIm = 0.0;
+}
+
+int Decimator::configure(float inRate, float outRate, float centerFreq, float ifFreq, float halfBandwidth)
+{
+  long in = (long)(inRate + 0.5f);
+  long out = (long)(outRate + 0.5f);
+  if ((in <= 0) || (out <= 0) || (out >= in))
+    return -1;
+
+  // the band must stay clear of 0 Hz and of the output Nyquist frequency
+  float passband = halfBandwidth;
+  float stopband = outRate * 0.5f - passband;
+  if ((ifFreq - passband <= 0.f) || (ifFreq + passband >= outRate * 0.5f) || (stopband <= passband))
+    return -2;
+
+  mInRate = inRate;
+  mOutRate = outRate;
+  mCenterFreq = centerFreq;
+  mIfFreq = ifFreq;
+
+  long g = gcdLong(in, out);
+  mUp = (int)(out / g);
+  mDown = (int)(in / g);
+
+  // Blackman windowed sinc designed at the upsampled rate (inRate * L).
+  // Its transition band is ~5.5 / N of that rate, so N = L * 5.5 * inRate / transition.
+  float transition = stopband - passband;
+  mTapsPerPhase = (int)ceil(5.5 * inRate / transition);
+  if (mTapsPerPhase < 8)
+    mTapsPerPhase = 8;
+  int ntaps = mTapsPerPhase * mUp;
+  double cutoff = 0.5 * (passband + stopband) / ((double)inRate * mUp); // normalized to upsampled rate
+
+  std::vector<double> h(ntaps);
+  double center = 0.5 * (ntaps - 1);
+  double dcgain = 0.0;
+  for (int i = 0; i < ntaps; i++)
+  {
+    double x = i - center;
+    double sinc = (x == 0.0) ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+    double w = 0.42 - 0.5 * cos(2.0 * M_PI * i / (ntaps - 1)) + 0.08 * cos(4.0 * M_PI * i / (ntaps - 1));
+    h[i] = sinc * w;
+    dcgain += h[i];
+  }
+
+  // unity gain per phase (zero stuffing by L loses a factor L)
+  double scale = (double)mUp / dcgain;
+
+  // split into polyphase branches, time-reversed so each output is a forward dot product
+  mPhases.assign(ntaps, 0.f);
+  for (int p = 0; p < mUp; p++)
+    for (int k = 0; k < mTapsPerPhase; k++)
+      mPhases[p * mTapsPerPhase + k] = (float)(h[p + (mTapsPerPhase - 1 - k) * mUp] * scale);
+
+  double wdown = 2.0 * M_PI * centerFreq / inRate;
+  mDownStepRe = cos(wdown);
+  mDownStepIm = -sin(wdown);
+  double wup = 2.0 * M_PI * ifFreq / outRate;
+  mUpStepRe = cos(wup);
+  mUpStepIm = sin(wup);
+
+  mHistRe.assign(2 * mTapsPerPhase, 0.f);
+  mHistIm.assign(2 * mTapsPerPhase, 0.f);
+
+  reset();
+
+  return 0;
+}
+
+void Decimator::reset()
+{
+  std::fill(mHistRe.begin(), mHistRe.end(), 0.f);
+  std::fill(mHistIm.begin(), mHistIm.end(), 0.f);
+  mHistPos = 0;
+  mPhase = 0;
+  mWait = 0;
+  mDownRe = 1.0; mDownIm = 0.0;
+  mUpRe = 1.0; mUpIm = 0.0;
+}
+
+int Decimator::process(const float *in, const int nsamples, float *out)
+{
+  int nout = 0;
+  const int T = mTapsPerPhase;
+
+  for (int i = 0; i < nsamples; i++)
+  {
+    // mix down to complex baseband
+    float re = (float)(in[i] * mDownRe);
+    float im = (float)(in[i] * mDownIm);
+    double t = mDownRe * mDownStepRe - mDownIm * mDownStepIm;
+    mDownIm = mDownRe * mDownStepIm + mDownIm * mDownStepRe;
+    mDownRe = t;
+
+    mHistRe[mHistPos] = re;
+    mHistRe[mHistPos + T] = re;
+    mHistIm[mHistPos] = im;
+    mHistIm[mHistPos + T] = im;
+    mHistPos++;
+    if (mHistPos == T)
+      mHistPos = 0;
+
+    while (mWait == 0)
+    {
+      // window of the last T samples, oldest first
+      const float *hr = &mHistRe[mHistPos];
+      const float *hi = &mHistIm[mHistPos];
+      const float *taps = &mPhases[mPhase * T];
+      float accRe = 0.f;
+      float accIm = 0.f;
+      for (int k = 0; k < T; k++)
+      {
+        accRe += taps[k] * hr[k];
+        accIm += taps[k] * hi[k];
+      }
+
+      // mix up to the intermediate frequency and keep the real part
+      out[nout++] = 2.f * (float)(accRe * mUpRe - accIm * mUpIm);
+      t = mUpRe * mUpStepRe - mUpIm * mUpStepIm;
+      mUpIm = mUpRe * mUpStepIm + mUpIm * mUpStepRe;
+      mUpRe = t;
+
+      mPhase += mDown;
+      mWait = mPhase / mUp;
+      mPhase = mPhase % mUp;
+    }
+    mWait--;
+  }
+
+  // keep the rotators on the unit circle
+  double mag = 1.0 / sqrt(mDownRe * mDownRe + mDownIm * mDownIm);
+  mDownRe *= mag; mDownIm *= mag;
+  mag = 1.0 / sqrt(mUpRe * mUpRe + mUpIm * mUpIm);
+  mUpRe *= mag; mUpIm *= mag;
+
+  return nout;
+}
@@ -0,0 +1,65 @@
+/*--------------------------------------------------------------------------------
+ Decimator.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef Decimator_h
+#define Decimator_h
+
+#include <vector>
+
+// Narrow-band front-end: shifts a band of the input signal to a low intermediate
+// frequency at a reduced sample rate.
+//
+// The input is mixed down to complex baseband (band center at 0 Hz), low-pass
+// filtered and resampled by L/M with a polyphase filter bank, then mixed up again
+// to ifFreq and returned as a real signal. A tone at f Hz in the input appears at
+// (f - centerFreq + ifFreq) Hz in the output, with the same amplitude.
+class Decimator{
+public:
+  Decimator();
+  ~Decimator() {};
+
+  // inRate and outRate must be integer rates with outRate < inRate.
+  // halfBandwidth is the one-sided width (Hz) of the band that must be preserved.
+  // returns 0 on success, <0 if the band does not fit in the output rate
+  int configure(float inRate, float outRate, float centerFreq, float ifFreq, float halfBandwidth);
+  void reset();
+
+  // processes nsamples of input, writes at most getMaxOutputSamples(nsamples) samples to out
+  // returns the number of output samples written
+  int process(const float *in, const int nsamples, float *out);
+  int getMaxOutputSamples(const int nsamples) { return (int)(((long)nsamples * mUp) / mDown) + 2; };
+
+  float getInputSampleRate() { return mInRate; };
+  float getOutputSampleRate() { return mOutRate; };
+  float getFrequencyShift() { return mCenterFreq - mIfFreq; };
+  int getUpFactor() { return mUp; };
+  int getDownFactor() { return mDown; };
+
+private:
+  float mInRate;
+  float mOutRate;
+  float mCenterFreq;
+  float mIfFreq;
+
+  int mUp;             // L
+  int mDown;           // M
+  int mTapsPerPhase;
+  std::vector<float> mPhases; // mUp phases of mTapsPerPhase taps, each stored time-reversed
+
+  // complex history, stored twice so that every window is contiguous
+  std::vector<float> mHistRe;
+  std::vector<float> mHistIm;
+  int mHistPos;
+
+  int mPhase;          // current polyphase branch
+  int mWait;           // input samples to consume before next output
+
+  // oscillators (complex rotators)
+  double mDownRe, mDownIm, mDownStepRe, mDownStepIm;
+  double mUpRe, mUpIm, mUpStepRe, mUpStepIm;
+};
+
+#endif /* Decimator_h */
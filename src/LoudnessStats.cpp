@@ -7,7 +7,7 @@
 #include "LoudnessStats.h"
 
 #include "sndfile.h"
-#include "ebur128.h"
+#include "PlanarIO.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -30,7 +30,7 @@ double test_global_loudness(const char* filename) {
   }
   st = ebur128_init((unsigned)file_info.channels,
     (unsigned)file_info.samplerate,
-    EBUR128_MODE_I);
+    EBUR128_MODE_I | EBUR128_MODE_HISTOGRAM);
   if (file_info.channels == 5) {
     ebur128_set_channel(st, 0, EBUR128_LEFT);
     ebur128_set_channel(st, 1, EBUR128_RIGHT);
@@ -107,3 +107,66 @@ double test_true_peak(const char* filename) {
   return 20 * log10(max_true_peak);
 }
 
+static const int kMeterFrames = 4096;
+
+LoudnessMeter::LoudnessMeter() {
+  mState = NULL;
+  mChannels = 0;
+  mGain = 1.f;
+}
+
+LoudnessMeter::~LoudnessMeter() {
+  if (mState)
+    ebur128_destroy(&mState);
+}
+
+int LoudnessMeter::configure(int channels, float sampleRate) {
+  if (mState)
+    ebur128_destroy(&mState);
+  mState = ebur128_init((unsigned)channels, (unsigned long)sampleRate,
+    EBUR128_MODE_I | EBUR128_MODE_HISTOGRAM);
+  if (!mState)
+    return -1;
+  mChannels = channels;
+  mGain = 1.f;
+  mScratch.resize((size_t)kMeterFrames * channels);
+  return 0;
+}
+
+void LoudnessMeter::add(const float* in, int nframes) {
+  if (!mState)
+    return;
+  if (mGain == 1.f) {
+    ebur128_add_frames_float(mState, in, (size_t)nframes);
+    return;
+  }
+  for (int done = 0; done < nframes; ) {
+    int n = (nframes - done < kMeterFrames) ? nframes - done : kMeterFrames;
+    const float* src = in + (size_t)done * mChannels;
+    for (int i = 0; i < n * mChannels; i++)
+      mScratch[i] = src[i] * mGain;
+    ebur128_add_frames_float(mState, &mScratch[0], (size_t)n);
+    done += n;
+  }
+}
+
+void LoudnessMeter::addPlanar(const float* const* in, long offset, int nframes) {
+  if (!mState)
+    return;
+  for (int done = 0; done < nframes; ) {
+    int n = (nframes - done < kMeterFrames) ? nframes - done : kMeterFrames;
+    PlanarIO::interleave(in, offset + done, n, mChannels, &mScratch[0]);
+    if (mGain != 1.f)
+      for (int i = 0; i < n * mChannels; i++)
+        mScratch[i] *= mGain;
+    ebur128_add_frames_float(mState, &mScratch[0], (size_t)n);
+    done += n;
+  }
+}
+
+double LoudnessMeter::getGlobalLoudness() {
+  double loudness = -HUGE_VAL;
+  if (mState)
+    ebur128_loudness_global(mState, &loudness);
+  return loudness;
+}
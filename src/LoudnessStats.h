@@ -7,7 +7,41 @@
 #ifndef _LOUDNESSSTATS_H_
 #define _LOUDNESSSTATS_H_
 
+#include <vector>
+
+#include "ebur128.h"
+
 double test_global_loudness(const char* filename);
 double test_true_peak(const char* filename);
 
+// Running integrated loudness of the frames given so far.
+//
+// The gating blocks go to the ebur128 energy histogram and the relative gate is kept
+// up to date as they are added, so getGlobalLoudness() walks the 1000 histogram bins
+// whatever the duration and memory does not grow with it.
+class LoudnessMeter{
+public:
+  LoudnessMeter();
+  ~LoudnessMeter();
+
+  // returns 0 on success, -1 if the state cannot be created
+  int configure(int channels, float sampleRate);
+  // gain applied to the frames before they are measured
+  void setGain(float gain) { mGain = gain; };
+
+  // nframes interleaved frames
+  void add(const float *in, int nframes);
+  // nframes frames of planar buffers starting at in[t] + offset
+  void addPlanar(const float *const *in, long offset, int nframes);
+
+  // gated loudness in LUFS, -HUGE_VAL while every block is below the absolute gate
+  double getGlobalLoudness();
+
+private:
+  ebur128_state *mState;
+  int mChannels;
+  float mGain;
+  std::vector<float> mScratch;
+};
+
 #endif //_LOUDNESSSTATS_H_
\ No newline at end of file
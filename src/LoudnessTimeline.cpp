@@ -0,0 +1,187 @@
+/*--------------------------------------------------------------------------------
+ LoudnessTimeline.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "LoudnessTimeline.h"
+
+#include "PlanarIO.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef MIN
+#define MIN(a,b) ((a <= b) ? (a) : (b))
+#endif
+
+static const int kScratchFrames = 4096;
+
+LoudnessTimeline::LoudnessTimeline()
+{
+  mFile = NULL;
+  mState = NULL;
+  mFormat = kCsv;
+  mChannels = 0;
+  mSampleRate = 44100.f;
+  mGain = 1.f;
+  mHopFrames = 0;
+  mHopPos = 0;
+  mFrames = 0;
+  mPoints = 0;
+  mError = false;
+}
+
+LoudnessTimeline::~LoudnessTimeline()
+{
+  close();
+  if (mState)
+    ebur128_destroy(&mState);
+}
+
+int LoudnessTimeline::open(const char *filename, int channels, float sampleRate, float hopSeconds, int format)
+{
+  close();
+  if (mState)
+    ebur128_destroy(&mState);
+
+  mHopFrames = (long)(hopSeconds * sampleRate + 0.5f);
+  if ((channels <= 0) || (mHopFrames <= 0) || ((format != kCsv) && (format != kBinary)))
+    return kNotSupported;
+
+  mState = ebur128_init((unsigned)channels, (unsigned long)sampleRate, EBUR128_MODE_LRA | EBUR128_MODE_HISTOGRAM);
+  if (!mState)
+    return kNotSupported;
+
+  mFile = fopen(filename, (format == kCsv) ? "w" : "wb");
+  if (!mFile)
+  {
+    ebur128_destroy(&mState);
+    return kCannotOpen;
+  }
+
+  mFormat = format;
+  mChannels = channels;
+  mSampleRate = sampleRate;
+  mGain = 1.f;
+  mHopPos = 0;
+  mFrames = 0;
+  mPoints = 0;
+  mError = false;
+  mScratch.resize((size_t)kScratchFrames * channels);
+
+  if (mFormat == kCsv)
+    mError = (fprintf(mFile, "time,momentary,shortterm,lra\n") < 0);
+  else
+  {
+    const uint32_t header[2] = { 0x544C4242, 1 }; // "BBLT" read as little endian, version
+    const uint32_t nch = (uint32_t)channels;
+    const float rates[2] = { sampleRate, (float)mHopFrames / sampleRate };
+    mError = (fwrite(header, sizeof(header), 1, mFile) != 1) || (fwrite(&nch, sizeof(nch), 1, mFile) != 1) || (fwrite(rates, sizeof(rates), 1, mFile) != 1);
+  }
+
+  return kOk;
+}
+
+void LoudnessTimeline::writePoint(double time)
+{
+  double momentary = -HUGE_VAL;
+  double shortterm = -HUGE_VAL;
+  ebur128_loudness_momentary(mState, &momentary);
+  ebur128_loudness_shortterm(mState, &shortterm);
+  double lra = getLoudnessRange();
+
+  if (mFormat == kCsv)
+  {
+    if (fprintf(mFile, "%.3f,%.2f,%.2f,%.2f\n", time, momentary, shortterm, lra) < 0)
+      mError = true;
+  }
+  else
+  {
+    const float point[3] = { (float)momentary, (float)shortterm, (float)lra };
+    if (fwrite(point, sizeof(point), 1, mFile) != 1)
+      mError = true;
+  }
+  mPoints++;
+}
+
+void LoudnessTimeline::addFrames(const float *in, int nframes)
+{
+  // the state is fed up to each hop boundary so the windows end exactly on the point
+  while (nframes > 0)
+  {
+    int n = (int)MIN((long)nframes, mHopFrames - mHopPos);
+    ebur128_add_frames_float(mState, in, (size_t)n);
+    in += (size_t)n * mChannels;
+    nframes -= n;
+    mHopPos += n;
+    mFrames += n;
+    if (mHopPos == mHopFrames)
+    {
+      writePoint((double)mFrames / mSampleRate);
+      mHopPos = 0;
+    }
+  }
+}
+
+int LoudnessTimeline::add(const float *in, int nframes)
+{
+  if (!mFile)
+    return 0;
+
+  if (mGain == 1.f)
+  {
+    addFrames(in, nframes);
+    return nframes;
+  }
+
+  for (int done = 0; done < nframes; )
+  {
+    int n = MIN(nframes - done, kScratchFrames);
+    const float *src = in + (size_t)done * mChannels;
+    for (int i = 0; i < n * mChannels; i++)
+      mScratch[i] = src[i] * mGain;
+    addFrames(&mScratch[0], n);
+    done += n;
+  }
+  return nframes;
+}
+
+int LoudnessTimeline::addPlanar(const float *const *in, long offset, int nframes)
+{
+  if (!mFile)
+    return 0;
+
+  for (int done = 0; done < nframes; )
+  {
+    int n = MIN(nframes - done, kScratchFrames);
+    PlanarIO::interleave(in, offset + done, n, mChannels, &mScratch[0]);
+    if (mGain != 1.f)
+      for (int i = 0; i < n * mChannels; i++)
+        mScratch[i] *= mGain;
+    addFrames(&mScratch[0], n);
+    done += n;
+  }
+  return nframes;
+}
+
+double LoudnessTimeline::getLoudnessRange()
+{
+  double lra = 0.0;
+  if (mState)
+    ebur128_loudness_range(mState, &lra);
+  return lra;
+}
+
+int LoudnessTimeline::close()
+{
+  if (!mFile)
+    return kOk;
+
+  // frames after the last full hop only count in the final loudness range
+  if (fclose(mFile) != 0)
+    mError = true;
+  mFile = NULL;
+  return mError ? kWriteError : kOk;
+}
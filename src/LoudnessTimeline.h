@@ -0,0 +1,69 @@
+/*--------------------------------------------------------------------------------
+ LoudnessTimeline.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef LoudnessTimeline_h
+#define LoudnessTimeline_h
+
+#include <stdio.h>
+#include <vector>
+
+#include "ebur128.h"
+
+// Loudness over time of the frames being written, measured in the same pass.
+//
+// Every hop a point is written with the momentary (400 ms) and short-term (3 s) loudness
+// ending at that time and the loudness range of everything so far. The ebur128 state runs
+// in histogram mode so the running LRA costs the same whatever the length of the file.
+// Windows are zero padded until enough audio has been seen.
+//
+// CSV:    "time,momentary,shortterm,lra" then one line per point (-inf below the gate)
+// binary: "BBLT", uint32 version, uint32 channels, float sample rate, float hop (secs),
+//         then 3 floats per point (momentary, shortterm, lra), point k is at (k + 1) * hop.
+//         Native byte order.
+class LoudnessTimeline{
+public:
+  enum { kCsv = 0, kBinary = 1 };
+  enum { kOk = 0, kCannotOpen = -1, kNotSupported = -2, kWriteError = -3 };
+
+  LoudnessTimeline();
+  ~LoudnessTimeline();
+
+  int open(const char *filename, int channels, float sampleRate, float hopSeconds, int format);
+  // gain applied to the frames before they are measured (the output gain of the writer)
+  void setGain(float gain) { mGain = gain; };
+
+  // nframes interleaved frames
+  int add(const float *in, int nframes);
+  // nframes frames of planar buffers starting at in[t] + offset
+  int addPlanar(const float *const *in, long offset, int nframes);
+
+  // closes the file, the frames after the last full hop give no point
+  // (the loudness range stays available until the next open())
+  int close();
+
+  long getNumPoints() { return mPoints; };
+  // loudness range of everything added so far, in LU
+  double getLoudnessRange();
+
+private:
+  void addFrames(const float *in, int nframes);
+  void writePoint(double time);
+
+  FILE *mFile;
+  ebur128_state *mState;
+  int mFormat;
+  int mChannels;
+  float mSampleRate;
+  float mGain;
+  long mHopFrames;
+  long mHopPos;             // frames since the last point
+  long mFrames;
+  long mPoints;
+  bool mError;
+  std::vector<float> mScratch;
+};
+
+#endif /* LoudnessTimeline_h */
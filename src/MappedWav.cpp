@@ -0,0 +1,257 @@
+/*--------------------------------------------------------------------------------
+ MappedWav.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "MappedWav.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+
+using namespace PcmConvert;
+
+// mapped 16 bit and float samples are converted as host words by PcmConvert
+#if defined(__BYTE_ORDER__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "MappedWav needs a little endian host");
+#endif
+
+MappedWavReader::MappedWavReader()
+{
+  mFd = -1;
+  mMap = NULL;
+  mMapSize = 0;
+  mData = NULL;
+  mChannels = 0;
+  mSampleRate = 0;
+  mSampleFormat = kPcm16;
+  mBytesPerFrame = 0;
+  mFrames = 0;
+  mPosition = 0;
+}
+
+MappedWavReader::~MappedWavReader()
+{
+  close();
+}
+
+int MappedWavReader::open(const char *filename)
+{
+  close();
+
+  mFd = ::open(filename, O_RDONLY);
+  if (mFd < 0)
+    return MappedWav::kCannotOpen;
+
+  struct stat st;
+  if ((fstat(mFd, &st) != 0) || (st.st_size < kWavHeaderSize))
+  {
+    close();
+    return MappedWav::kNotSupported;
+  }
+  mMapSize = (long)st.st_size;
+
+  void *map = mmap(NULL, mMapSize, PROT_READ, MAP_SHARED, mFd, 0);
+  if (map == MAP_FAILED)
+  {
+    mMapSize = 0;
+    close();
+    return MappedWav::kNotSupported;
+  }
+  mMap = (uint8_t *)map;
+
+  if ((memcmp(mMap, "RIFF", 4) != 0) || (memcmp(mMap + 8, "WAVE", 4) != 0))
+  {
+    close();
+    return MappedWav::kNotSupported;
+  }
+
+  // walk the chunks for "fmt " and "data"
+  int sampleFormat = -1;
+  long dataOffset = 0;
+  long dataSize = 0;
+  long pos = 12;
+  while (pos + 8 <= mMapSize)
+  {
+    long chunkSize = (long)readU32(mMap + pos + 4);
+    if (memcmp(mMap + pos, "fmt ", 4) == 0)
+    {
+      if (pos + 8 + chunkSize > mMapSize)
+        break;
+      sampleFormat = parseFormatChunk(mMap + pos + 8, chunkSize, mChannels, mSampleRate);
+    }
+    else if (memcmp(mMap + pos, "data", 4) == 0)
+    {
+      dataOffset = pos + 8;
+      dataSize = (chunkSize > mMapSize - dataOffset) ? mMapSize - dataOffset : chunkSize; // streamed files leave the size unset
+      break;
+    }
+    pos += 8 + chunkSize + (chunkSize & 1);
+  }
+
+  if ((sampleFormat < 0) || (dataOffset == 0))
+  {
+    close();
+    return MappedWav::kNotSupported;
+  }
+
+  mSampleFormat = sampleFormat;
+  mBytesPerFrame = mChannels * bytesPerSample(mSampleFormat);
+  mData = mMap + dataOffset;
+  mFrames = dataSize / mBytesPerFrame;
+  mPosition = 0;
+  madvise(mMap, mMapSize, MADV_SEQUENTIAL);
+
+  return MappedWav::kOk;
+}
+
+void MappedWavReader::close()
+{
+  if (mMap)
+    munmap(mMap, mMapSize);
+  if (mFd >= 0)
+    ::close(mFd);
+  mFd = -1;
+  mMap = NULL;
+  mMapSize = 0;
+  mData = NULL;
+  mFrames = 0;
+  mPosition = 0;
+}
+
+int MappedWavReader::read(float *out, int nframes)
+{
+  long available = mFrames - mPosition;
+  int n = (nframes < available) ? nframes : (int)available;
+  if (n <= 0)
+    return 0;
+
+  toFloat(mData + mPosition * mBytesPerFrame, mSampleFormat, n * mChannels, out);
+
+  mPosition += n;
+  return n;
+}
+
+MappedWavWriter::MappedWavWriter()
+{
+  mFd = -1;
+  mMap = NULL;
+  mMapSize = 0;
+  mData = NULL;
+  mChannels = 0;
+  mSampleFormat = kPcm16;
+  mBytesPerFrame = 0;
+  mFrames = 0;
+  mPosition = 0;
+  mGain = 1.f;
+  mSync = false;
+}
+
+MappedWavWriter::~MappedWavWriter()
+{
+  close();
+}
+
+// allocates the blocks of the whole file so that a full disk or quota fails here, not
+// with a SIGBUS while the samples are written through the map. returns 0 on success
+static int reserveFile(int fd, long size)
+{
+#ifdef __APPLE__
+  fstore_t store = { F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)size, 0 };
+  if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+  {
+    store.fst_flags = F_ALLOCATEALL;
+    if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+      return -1;
+  }
+  return ftruncate(fd, size);
+#else
+  return posix_fallocate(fd, 0, size);
+#endif
+}
+
+int MappedWavWriter::create(const char *filename, int channels, int sampleRate, long frames, int sampleFormat)
+{
+  close();
+
+  int sampleBytes = bytesPerSample(sampleFormat);
+  long dataSize = frames * channels * sampleBytes;
+  if ((channels <= 0) || (frames < 0) || (kWavHeaderSize - 8 + dataSize + (dataSize & 1) > 0xFFFFFFFFL))
+    return MappedWav::kNotSupported;
+
+  mFd = ::open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (mFd < 0)
+    return MappedWav::kCannotOpen;
+
+  mMapSize = kWavHeaderSize + dataSize + (dataSize & 1);
+  if (reserveFile(mFd, mMapSize) != 0)
+  {
+    ftruncate(mFd, 0); // gives back the blocks that were allocated
+    close();
+    return MappedWav::kCannotOpen;
+  }
+
+  void *map = mmap(NULL, mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+  if (map == MAP_FAILED)
+  {
+    close();
+    return MappedWav::kCannotOpen;
+  }
+  mMap = (uint8_t *)map;
+  madvise(mMap, mMapSize, MADV_SEQUENTIAL);
+
+  writeWavHeader(mMap, channels, sampleRate, sampleFormat, (uint32_t)dataSize);
+
+  mData = mMap + kWavHeaderSize;
+  mChannels = channels;
+  mSampleFormat = sampleFormat;
+  mBytesPerFrame = channels * sampleBytes;
+  mFrames = frames;
+  mPosition = 0;
+
+  return MappedWav::kOk;
+}
+
+int MappedWavWriter::close()
+{
+  // the blocks were reserved by create(), the kernel writes the pages back after the unmap.
+  // With setSync(true) the pages and the file are flushed first and their errors show up here
+  bool error = false;
+  if (mMap)
+  {
+    if (mSync && (msync(mMap, mMapSize, MS_SYNC) != 0))
+      error = true;
+    if (munmap(mMap, mMapSize) != 0)
+      error = true;
+  }
+  if (mFd >= 0)
+  {
+    if (mSync && (fsync(mFd) != 0))
+      error = true;
+    if (::close(mFd) != 0)
+      error = true;
+  }
+  mFd = -1;
+  mMap = NULL;
+  mMapSize = 0;
+  mData = NULL;
+  mFrames = 0;
+  mPosition = 0;
+  return error ? MappedWav::kWriteError : MappedWav::kOk;
+}
+
+int MappedWavWriter::write(const float *in, int nframes)
+{
+  long available = mFrames - mPosition;
+  int n = (nframes < available) ? nframes : (int)available;
+  if (n <= 0)
+    return 0;
+
+  fromFloat(in, mSampleFormat, n * mChannels, mData + mPosition * mBytesPerFrame, mGain);
+
+  mPosition += n;
+  return n;
+}
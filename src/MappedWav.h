@@ -0,0 +1,89 @@
+/*--------------------------------------------------------------------------------
+ MappedWav.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef MappedWav_h
+#define MappedWav_h
+
+#include <stdint.h>
+
+#include "PcmConvert.h"
+
+// Memory-mapped access to plain RIFF/WAVE files with 16 bit, 24 bit or 32 bit float
+// PCM samples (little endian hosts). Samples are converted between the mapped pages
+// and interleaved float frames in blocks, without the libsndfile bounce buffers.
+// Sample formats are the PcmConvert ones. Anything else (compressed formats, RF64, other sample sizes) is left to libsndfile:
+// open() and create() then return kNotSupported.
+namespace MappedWav
+{
+  enum { kOk = 0, kCannotOpen = -1, kNotSupported = -2, kWriteError = -3 };
+}
+
+class MappedWavReader{
+public:
+  MappedWavReader();
+  ~MappedWavReader();
+
+  int open(const char *filename);
+  void close();
+
+  // reads up to nframes interleaved frames from the current position
+  // returns the number of frames read, 0 at the end of the file
+  int read(float *out, int nframes);
+  void seek(long frame) { mPosition = (frame < mFrames) ? frame : mFrames; };
+
+  int getChannels() { return mChannels; };
+  int getSampleRate() { return mSampleRate; };
+  long getFrames() { return mFrames; };
+  int getSampleFormat() { return mSampleFormat; };
+
+private:
+  int mFd;
+  uint8_t *mMap;
+  long mMapSize;
+  const uint8_t *mData;
+  int mChannels;
+  int mSampleRate;
+  int mSampleFormat;
+  int mBytesPerFrame;
+  long mFrames;
+  long mPosition;
+};
+
+class MappedWavWriter{
+public:
+  MappedWavWriter();
+  ~MappedWavWriter();
+
+  // creates a file sized for frames frames, with its blocks allocated, and writes its header
+  // returns kCannotOpen if the file cannot be created or the disk has no room for it
+  int create(const char *filename, int channels, int sampleRate, long frames, int sampleFormat);
+  // unmaps and closes the file, frames that were not written are left as silence
+  // returns kOk or kWriteError if the file could not be written
+  int close();
+
+  // writes up to nframes interleaved frames at the current position
+  // returns the number of frames written
+  int write(const float *in, int nframes);
+  // gain applied to the frames while they are converted
+  void setGain(float gain) { mGain = gain; };
+  // close() waits until the samples are on the disk (msync and fsync), off by default
+  void setSync(bool sync) { mSync = sync; };
+
+private:
+  int mFd;
+  uint8_t *mMap;
+  long mMapSize;
+  uint8_t *mData;
+  int mChannels;
+  int mSampleFormat;
+  int mBytesPerFrame;
+  long mFrames;
+  long mPosition;
+  float mGain;
+  bool mSync;
+};
+
+#endif /* MappedWav_h */
@@ -0,0 +1,58 @@
+/*--------------------------------------------------------------------------------
+ MarkCode.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "MarkCode.h"
+
+// front door tokens "1o"
+static const uint8_t kFrontDoor[MarkCode::kNumFrontDoor] = { 1, 24 };
+
+void MarkCode::encode(const Payload *payloads, int count, uint8_t *codes)
+{
+  mMessages.resize((size_t)count * kNumMessage);
+  for (int n = 0; n < count; n++)
+  {
+    uint8_t *message = &mMessages[(size_t)n * kNumMessage];
+    message[0] = kFrontDoor[0];
+    message[1] = kFrontDoor[1];
+    int check = 0;
+    for (int i = 0; i < Payload::kNumChars; i++)
+    {
+      message[kNumFrontDoor + i] = (uint8_t)payloads[n].getSymbol(i);
+      check += message[kNumFrontDoor + i];
+    }
+    message[kNumMessage - 1] = (uint8_t)(check & 31);
+  }
+  mCodec.encode(mMessages.data(), count, codes);
+}
+
+int MarkCode::decode(const uint8_t *codes, int count, Payload *payloads, int *status)
+{
+  mMessages.resize((size_t)count * kNumMessage);
+  mStatus.resize((size_t)count);
+  int failed = mCodec.decode(codes, count, mMessages.data(), mStatus.data());
+
+  for (int n = 0; n < count; n++)
+  {
+    const uint8_t *message = &mMessages[(size_t)n * kNumMessage];
+    uint64_t value = 0;
+    int check = 0;
+    for (int i = 0; i < Payload::kNumChars; i++)
+    {
+      value = (value << Payload::kBitsPerChar) | message[kNumFrontDoor + i];
+      check += message[kNumFrontDoor + i];
+    }
+    payloads[n] = Payload(value);
+
+    if ((mStatus[n] >= 0) && ((message[0] != kFrontDoor[0]) || (message[1] != kFrontDoor[1]) || (message[kNumMessage - 1] != (check & 31))))
+    {
+      mStatus[n] = -1;
+      failed++;
+    }
+    if (status)
+      status[n] = mStatus[n];
+  }
+  return failed;
+}
@@ -0,0 +1,45 @@
+/*--------------------------------------------------------------------------------
+ MarkCode.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef MarkCode_h
+#define MarkCode_h
+
+#include <stdint.h>
+#include <vector>
+
+#include "Payload.h"
+#include "RSCodec.h"
+
+// Token sequence of an audio mark as built by BeepingCore: the 2 front door tokens,
+// the 9 payload tokens and a check token (sum of the payload tokens mod 32) form the
+// message, followed by the 8 Reed-Solomon parity tokens.
+class MarkCode{
+public:
+  enum
+  {
+    kNumFrontDoor = 2,
+    kNumMessage = BeepingRSCodec::kMessageLen,
+    kNumTokens = BeepingRSCodec::kCodeLen
+  };
+
+  MarkCode() {};
+  ~MarkCode() {};
+
+  // writes count codewords of kNumTokens tokens
+  void encode(const Payload *payloads, int count, uint8_t *codes);
+
+  // corrects count codewords and extracts their payloads, status (optional, count entries)
+  // as in RSCodec::decode. A codeword with a wrong front door or check token gets status -1
+  // returns the number of codewords that could not be decoded
+  int decode(const uint8_t *codes, int count, Payload *payloads, int *status);
+
+private:
+  BeepingRSCodec mCodec;
+  std::vector<uint8_t> mMessages;
+  std::vector<int> mStatus;
+};
+
+#endif /* MarkCode_h */
@@ -0,0 +1,80 @@
+/*--------------------------------------------------------------------------------
+ MarkEncoder.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "MarkEncoder.h"
+
+#include "BeepingCoreLib_api.h"
+#include "Globals.h"
+#include "MarkCode.h"
+
+#include <string.h>
+#include <iostream>
+
+CoreMarkEncoder::CoreMarkEncoder(void *beepingCore, float samplingRate, int bufferSize, int synthType)
+{
+  mBeepingCore = beepingCore;
+  mBufferSize = bufferSize;
+  mSynthType = synthType;
+  // tokens of a mark, rounded up to whole pieces
+  int markSamples = MarkCode::kNumTokens * (int)(Globals::durToken * samplingRate);
+  if (synthType != 0)
+  {
+    // R2D2 and melody sounds make the mark longer by an amount only the core knows: ask it
+    // with a probe mark, which is dropped. Tone marks are always kNumTokens tokens long
+    char probe[Payload::kNumChars + 1];
+    Payload().toString(probe);
+    int probeSamples = BEEPING_EncodeDataToAudioBuffer(probe, Payload::kNumChars, synthType, 0, 0, beepingCore);
+    BEEPING_ResetEncodedAudioBuffer(beepingCore);
+    if (probeSamples > markSamples)
+      markSamples = probeSamples;
+  }
+  mMaxMarkSamples = ((markSamples + bufferSize - 1) / bufferSize + 1) * bufferSize;
+  mChunk = new float[bufferSize];
+}
+
+CoreMarkEncoder::~CoreMarkEncoder()
+{
+  delete[] mChunk;
+}
+
+int CoreMarkEncoder::render(const Payload &payload, float *dst, float gain)
+{
+  char stringToEncode[Payload::kNumChars + 1];
+  payload.toString(stringToEncode);
+
+  int encodedSamples = BEEPING_EncodeDataToAudioBuffer(stringToEncode, Payload::kNumChars, mSynthType, 0, 0, mBeepingCore);
+  if (encodedSamples > mMaxMarkSamples)
+  {
+    std::cerr << "Audio mark " << stringToEncode << " has " << encodedSamples << " samples, only " << mMaxMarkSamples << " fit in the beeps buffer. The mark is cut" << std::endl;
+    encodedSamples = mMaxMarkSamples;
+  }
+
+  int samples = 0;
+  while (samples < encodedSamples)
+  {
+    // pieces go straight to dst while a whole piece still fits, the gain is applied in place
+    float *chunk = (samples + mBufferSize <= mMaxMarkSamples) ? dst + samples : mChunk;
+    int samplesRetrieved = BEEPING_GetEncodedAudioBuffer(chunk, mBeepingCore);
+    if (samplesRetrieved <= 0)
+      break;
+    if (samplesRetrieved > encodedSamples - samples)
+      samplesRetrieved = encodedSamples - samples;
+    if (chunk == mChunk)
+    {
+      for (int i = 0; i < samplesRetrieved; i++)
+        dst[samples + i] = gain * mChunk[i];
+    }
+    else if (gain != 1.f)
+    {
+      for (int i = 0; i < samplesRetrieved; i++)
+        chunk[i] *= gain;
+    }
+    samples += samplesRetrieved;
+  }
+
+  BEEPING_ResetEncodedAudioBuffer(mBeepingCore);
+  return samples;
+}
@@ -0,0 +1,43 @@
+/*--------------------------------------------------------------------------------
+ MarkEncoder.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef MarkEncoder_h
+#define MarkEncoder_h
+
+#include "Payload.h"
+
+// Renders complete audio marks straight into a caller buffer (the beeps track or an
+// output block), applying a gain in the same pass.
+class MarkEncoder{
+public:
+  virtual ~MarkEncoder() {};
+
+  // renders one mark at dst, which must hold getMaxMarkSamples() samples
+  // returns the number of samples of the mark
+  virtual int render(const Payload &payload, float *dst, float gain) = 0;
+  virtual int getMaxMarkSamples() = 0;
+};
+
+// Marks encoded by BeepingCore, which hands them out in bufferSize pieces. The core must
+// already be configured with the same sampling rate, buffer size and synth mode: with a
+// synth sound (synthType 1 or 2) the constructor encodes a probe mark to learn its length.
+class CoreMarkEncoder : public MarkEncoder{
+public:
+  CoreMarkEncoder(void *beepingCore, float samplingRate, int bufferSize, int synthType);
+  ~CoreMarkEncoder();
+
+  int render(const Payload &payload, float *dst, float gain);
+  int getMaxMarkSamples() { return mMaxMarkSamples; };
+
+private:
+  void *mBeepingCore;
+  int mBufferSize;
+  int mSynthType;
+  int mMaxMarkSamples;
+  float *mChunk;
+};
+
+#endif /* MarkEncoder_h */
@@ -0,0 +1,146 @@
+/*--------------------------------------------------------------------------------
+ Metrics.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "Metrics.h"
+
+#include <chrono>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+std::atomic<const char*> Metrics::sStage(NULL);
+std::atomic<long> Metrics::sFrames(0);
+std::atomic<long> Metrics::sTotalFrames(0);
+std::atomic<float> Metrics::sSampleRate(0.f);
+std::atomic<int64_t> Metrics::sStageStart(0);
+std::atomic<int64_t> Metrics::sStart(0);
+
+int64_t Metrics::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Metrics::beginStage(const char *stage, long totalFrames, float sampleRate)
+{
+  int64_t t = now();
+  int64_t unset = 0;
+  sStart.compare_exchange_strong(unset, t, std::memory_order_relaxed);
+  sFrames.store(0, std::memory_order_relaxed);
+  sTotalFrames.store(totalFrames, std::memory_order_relaxed);
+  sSampleRate.store(sampleRate, std::memory_order_relaxed);
+  sStageStart.store(t, std::memory_order_relaxed);
+  sStage.store(stage, std::memory_order_release);
+}
+
+void Metrics::getSnapshot(Snapshot &snapshot)
+{
+  int64_t t = now();
+  snapshot.stage = sStage.load(std::memory_order_acquire);
+  snapshot.frames = sFrames.load(std::memory_order_relaxed);
+  snapshot.totalFrames = sTotalFrames.load(std::memory_order_relaxed);
+  snapshot.sampleRate = sSampleRate.load(std::memory_order_relaxed);
+  int64_t stageStart = sStageStart.load(std::memory_order_relaxed);
+  int64_t start = sStart.load(std::memory_order_relaxed);
+  snapshot.stageSeconds = (stageStart > 0) ? (t - stageStart) * 1e-9 : 0.0;
+  snapshot.seconds = (start > 0) ? (t - start) * 1e-9 : 0.0;
+}
+
+long Metrics::getResidentBytes()
+{
+  // current resident set from procfs, peak resident set where there is no procfs
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (file)
+  {
+    long size = 0, resident = 0;
+    int n = fscanf(file, "%ld %ld", &size, &resident);
+    fclose(file);
+    if (n == 2)
+      return resident * sysconf(_SC_PAGESIZE);
+  }
+
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return (long)usage.ru_maxrss;         // bytes
+#else
+  return (long)usage.ru_maxrss * 1024;  // kilobytes
+#endif
+}
+
+MetricsReporter::MetricsReporter()
+{
+  mFile = NULL;
+  mIntervalMs = 1000;
+  mStopping = false;
+}
+
+MetricsReporter::~MetricsReporter()
+{
+  stop();
+}
+
+int MetricsReporter::start(const char *filename, int intervalMs)
+{
+  stop();
+
+  mFile = (strcmp(filename, "-") == 0) ? stderr : fopen(filename, "w");
+  if (!mFile)
+    return -1;
+
+  mIntervalMs = (intervalMs > 0) ? intervalMs : 1000;
+  mStopping = false;
+  mThread = std::thread(&MetricsReporter::run, this);
+  return 0;
+}
+
+void MetricsReporter::stop()
+{
+  if (!mFile)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+  }
+  mWake.notify_one();
+  if (mThread.joinable())
+    mThread.join();
+
+  report();
+  if (mFile != stderr)
+    fclose(mFile);
+  mFile = NULL;
+}
+
+void MetricsReporter::run()
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (!mWake.wait_for(lock, std::chrono::milliseconds(mIntervalMs), [this] { return mStopping; }))
+    report();
+}
+
+void MetricsReporter::report()
+{
+  Metrics::Snapshot s;
+  Metrics::getSnapshot(s);
+  if (!s.stage)
+    return;
+
+  double audioSeconds = (s.sampleRate > 0.f) ? s.frames / (double)s.sampleRate : 0.0;
+  double xrt = (s.stageSeconds > 0.0) ? audioSeconds / s.stageSeconds : 0.0;
+
+  fprintf(mFile, "{\"time\":%.2f,\"stage\":\"%s\",\"frames\":%ld,\"total\":%ld,", s.seconds, s.stage, s.frames, s.totalFrames);
+  if ((s.totalFrames > 0) && (s.frames > 0))
+  {
+    double eta = s.stageSeconds * (double)(s.totalFrames - s.frames) / (double)s.frames;
+    fprintf(mFile, "\"progress\":%.1f,\"xrt\":%.1f,\"rss_mb\":%.1f,\"eta\":%.2f}\n",
+            100.0 * s.frames / s.totalFrames, xrt, Metrics::getResidentBytes() / 1048576.0, (eta > 0.0) ? eta : 0.0);
+  }
+  else
+    fprintf(mFile, "\"progress\":null,\"xrt\":%.1f,\"rss_mb\":%.1f,\"eta\":null}\n", xrt, Metrics::getResidentBytes() / 1048576.0);
+  fflush(mFile);
+}
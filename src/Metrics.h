@@ -0,0 +1,83 @@
+/*--------------------------------------------------------------------------------
+ Metrics.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef Metrics_h
+#define Metrics_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Progress of the running stage, shared by the whole process.
+//
+// Stages update it with relaxed atomic stores once per block, never per sample, and
+// nothing is formatted or printed by them: the MetricsReporter thread reads it at a
+// low rate and writes the report.
+class Metrics{
+public:
+  // stage must be a string literal (it is read later by the reporter thread)
+  // totalFrames <= 0 if the length of the stage is not known
+  static void beginStage(const char *stage, long totalFrames, float sampleRate);
+  static void setFrames(long frames) { sFrames.store(frames, std::memory_order_relaxed); };
+  static void addFrames(long frames) { sFrames.fetch_add(frames, std::memory_order_relaxed); };
+
+  struct Snapshot
+  {
+    const char *stage;
+    long frames;
+    long totalFrames;
+    float sampleRate;
+    double stageSeconds;   // wall time since the stage began
+    double seconds;        // wall time since the first stage began
+  };
+  static void getSnapshot(Snapshot &snapshot);
+
+  // resident memory of the process in bytes, 0 if unknown
+  static long getResidentBytes();
+
+  // monotonic wall clock in nanoseconds
+  static int64_t now();
+
+private:
+  static std::atomic<const char*> sStage;
+  static std::atomic<long> sFrames;
+  static std::atomic<long> sTotalFrames;
+  static std::atomic<float> sSampleRate;
+  static std::atomic<int64_t> sStageStart;
+  static std::atomic<int64_t> sStart;
+};
+
+// Writes the Metrics as JSON lines from its own thread:
+//   {"time":1.20,"stage":"save","frames":441000,"total":882000,"progress":50.0,
+//    "xrt":180.3,"rss_mb":42.1,"eta":1.20}
+// xrt is the audio duration processed per second of wall time in the stage, eta and
+// progress are null when the stage length is not known.
+class MetricsReporter{
+public:
+  MetricsReporter();
+  ~MetricsReporter();
+
+  // filename "-" writes to stderr. returns 0 on success, -1 if the file cannot be created
+  int start(const char *filename, int intervalMs = 1000);
+  // writes a last line and stops the thread
+  void stop();
+
+private:
+  void run();
+  void report();
+
+  FILE *mFile;
+  int mIntervalMs;
+  std::thread mThread;
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  bool mStopping;
+};
+
+#endif /* Metrics_h */
@@ -5,6 +5,8 @@
  --------------------------------------------------------------------------------*/
 
 #include "Mixer.h"
+#include "Metrics.h"
+#include "StageTimers.h"
 
 #include <strstream>
 #include <iostream>
@@ -27,88 +29,178 @@ int Mixer::mix(const float** bufferPgm, const int nsamples, int nchannels, const
   std::vector<float> timestamps;
   std::vector<float> beepLevel;
   float percentile10;
+
+  // beeps go to the placement channels only, the analysis follows those channels
+  std::vector<float> gains;
+  getBeepChannelGains(mBeepPlacement, nchannels, gains);
+  std::vector<float> weights(gains);
+  float nbeep = 0.f;
+  for (int j=0; j < nchannels; j++)
+    nbeep += gains[j];
+  for (int j=0; j < nchannels; j++)
+    weights[j] = (nbeep > 0.f) ? gains[j] / nbeep : 0.f;
   
-  computeBeepLevel(bufferPgm[0], nsamples, samplerate, timestamps, beepLevel, percentile10);
+  computeBeepLevel(bufferPgm, nchannels, weights, nsamples, samplerate, timestamps, beepLevel, percentile10);
   int ntimestamps = beepLevel.size()-2;
 
   // get linear gain values
   float defBeepLevel = pow(10.f, mDefaultBeepLevel/20.f);
   float defPgmLevel = pow(10.f, mDefaultProgramLevel/20.f);
+
+  if ((mMode != kDynamicLevelMode) && (mMode != kGlobalLevelMode) && (mMode != kDefaultMode))
+    return 1;
   
   std::cout << "Progress MIX = " << 95 << std::endl;
 
+  float globalBeepLevel = defBeepLevel;
+  if (mMode == kGlobalLevelMode)
+  {
+    float minlevelLin = pow(10.f, mMinBeepLevel/20.f);
+    float globalLevelDB = percentile10 + mDefaultBeepLevel;
+    globalBeepLevel = std::max(minlevelLin, std::min(.95f, powf(10.f, globalLevelDB /20.f))); // TODO
+  }
+
+  if (mUseLimiter)
+    mLimiter.configure(nchannels, samplerate, mLimiterCeiling);
+
+  // mixed in blocks so that the limiter works on samples still in cache, the limited
+  // output lags the mix by the limiter latency and may overwrite the mixed block
+  const int blockSize = 4096;
+  std::vector<float> &levels = mScratch;
+  levels.resize(blockSize);
+  Metrics::beginStage("mix", nsamples, samplerate);
   float maxpeak = 0.;
-  if (mMode == kDynamicLevelMode)
+  int eidx = 0; // energy index
+  long written = 0;
+  for (int pos=0; pos < nsamples; pos += blockSize)
   {
-    int eidx = 0; // energy index
-    float level = 1.f;
-    float interp = 0.f;
-    
-    for (int i=0; i < nsamples; i++)
+    ScopedTimer timer("mix");
+    const int n = std::min(blockSize, nsamples - pos);
+
+    // beeps level per sample
+    if (mMode == kDynamicLevelMode)
     {
-      // get current index in energy timestamps
-      if ((i/samplerate) > timestamps[eidx+1])
-        eidx++;
-      eidx = std::min(eidx, ntimestamps);
-      
-      // interpolate level value per sample
-      interp = ((i/samplerate) - timestamps[eidx])/ (timestamps[eidx+1] - timestamps[eidx]);
-      level = (1.f - interp) * beepLevel[eidx] + interp * beepLevel[eidx+1];
-      // mix buffers
-      for (int j=0; j < nchannels; j++){
-        bufferMix[j][i] = MAX(-1.0, MIN(1.0, level * bufferBeeps[i] + defPgmLevel * bufferPgm[j][i]));
-        // update max peak
-        maxpeak = (abs(bufferMix[j][i]) > maxpeak) ? abs(bufferMix[j][i]) : maxpeak;
-      }
-    }
-  }
-  else
-    if (mMode == kGlobalLevelMode){
-      
-      float minlevelLin = pow(10.f, mMinBeepLevel/20.f);
-      float globalLevelDB = percentile10 + mDefaultBeepLevel;
-      float globalBeepLevel = std::max(minlevelLin, std::min(.95f, powf(10.f, globalLevelDB /20.f))); // TODO
-      
-      // apply default gain for all channels
-      for (int i=0; i < nsamples; i++)
-        for (int j=0; j < nchannels; j++){
-          bufferMix[j][i] = MAX(-1.0, MIN(1.0, globalBeepLevel * bufferBeeps[i] + defPgmLevel * bufferPgm[j][i]));
-          // update max peak
-          maxpeak = (abs(bufferMix[j][i]) > maxpeak) ? abs(bufferMix[j][i]) : maxpeak;
-        }
-    }
-    else
-      if (mMode == kDefaultMode)
+      float level = 1.f;
+      float interp = 0.f;
+      for (int i=pos; i < pos+n; i++)
       {
-        // apply default gain for all channels
-        for (int i=0; i < nsamples; i++)
-          for (int j=0; j < nchannels; j++){
-
-            //bufferMix[j][i] = defBeepLevel * bufferBeeps[i] + defPgmLevel * bufferPgm[j][i];
-            bufferMix[j][i] = MAX(-1.0,MIN(1.0,defBeepLevel * bufferBeeps[i] + defPgmLevel * bufferPgm[j][i]));
-            // update max peak
-            maxpeak = (abs(bufferMix[j][i]) > maxpeak) ? abs(bufferMix[j][i]) : maxpeak;
-          }
+        // get current index in energy timestamps
+        if ((i/samplerate) > timestamps[eidx+1])
+          eidx++;
+        eidx = std::min(eidx, ntimestamps);
+        
+        // interpolate level value per sample
+        interp = ((i/samplerate) - timestamps[eidx])/ (timestamps[eidx+1] - timestamps[eidx]);
+        level = (1.f - interp) * beepLevel[eidx] + interp * beepLevel[eidx+1];
+        levels[i-pos] = level;
       }
-      else
+    }
+    else // global level, or default level
+      std::fill(levels.begin(), levels.begin() + n, globalBeepLevel);
+
+    // mix buffers, hard clipped unless the limiter takes care of the peaks
+    for (int j=0; j < nchannels; j++)
+    {
+      const float *pgm = bufferPgm[j] + pos;
+      float *out = bufferMix[j] + pos;
+      for (int i=0; i < n; i++)
       {
-        return 1;
+        float v = gains[j] * levels[i] * bufferBeeps[pos+i] + defPgmLevel * pgm[i];
+        out[i] = mUseLimiter ? v : MAX(-1.0, MIN(1.0, v));
+        // update max peak
+        maxpeak = std::max(maxpeak, fabsf(out[i]));
       }
+    }
+
+    if (mUseLimiter)
+      written += mLimiter.process((const float* const*)bufferMix, pos, n, bufferMix, written);
+    Metrics::setFrames(pos + n);
+  }
+  if (mUseLimiter)
+  {
+    mLimiter.flush(bufferMix, written, (int)(nsamples - written));
+    std::cout << "Limiter gain reduction = " << -mLimiter.getMaxReductionDB() << " dB" << std::endl;
+  }
   
-  // might be disabled for optimization
-  if (mUseNormalize)
-    for (int i=0; i < nsamples; i++)
-      for (int j=0; j < nchannels; j++)
-        bufferMix[j][i] /= maxpeak;
+  // normalization is deferred to the writer (getOutputGain()), the limiter already keeps the ceiling
+  mOutputGain = 1.f;
+  if (mUseNormalize && !mUseLimiter && (maxpeak > 0.f))
+    mOutputGain = 1.f / maxpeak;
   
   std::cout << "Progress MIX = " << 100 << std::endl;
 
   return 0;
 }
 
+void Mixer::beginBlocks(int nchannels, const float samplerate)
+{
+  getBeepChannelGains(mBeepPlacement, nchannels, mBlockGains);
+  if (mUseLimiter)
+    mLimiter.configure(nchannels, samplerate, mLimiterCeiling);
+}
+
+int Mixer::mixBlock(const float** bufferPgm, const int nsamples, int nchannels, const float* bufferBeeps, float** bufferMix)
+{
+  float defBeepLevel = pow(10.f, mDefaultBeepLevel/20.f);
+  float defPgmLevel = pow(10.f, mDefaultProgramLevel/20.f);
+
+  std::vector<float> &gains = mBlockGains;
+  if ((int)gains.size() != nchannels)
+    getBeepChannelGains(mBeepPlacement, nchannels, gains);
+
+  for (int j=0; j < nchannels; j++)
+  {
+    float beepLevel = gains[j] * defBeepLevel;
+    if (mUseLimiter)
+      for (int i=0; i < nsamples; i++)
+        bufferMix[j][i] = beepLevel * bufferBeeps[i] + defPgmLevel * bufferPgm[j][i];
+    else
+      for (int i=0; i < nsamples; i++)
+        bufferMix[j][i] = MAX(-1.0, MIN(1.0, beepLevel * bufferBeeps[i] + defPgmLevel * bufferPgm[j][i]));
+  }
+
+  if (mUseLimiter)
+    return mLimiter.process((const float* const*)bufferMix, 0, nsamples, bufferMix, 0);
+  return nsamples;
+}
+
+float Mixer::getBlockPeakBound(float programPeak, float beepsPeak)
+{
+  float defBeepLevel = pow(10.f, mDefaultBeepLevel/20.f);
+  float defPgmLevel = pow(10.f, mDefaultProgramLevel/20.f);
+  float bound = defPgmLevel * programPeak + defBeepLevel * beepsPeak;
+  return mUseLimiter ? std::min(bound, mLimiter.getCeiling()) : std::min(bound, 1.f);
+}
+
+int Mixer::flushBlocks(float** bufferMix, long offset, int maxFrames)
+{
+  if (!mUseLimiter)
+    return 0;
+  return mLimiter.flush(bufferMix, offset, maxFrames);
+}
+
+void Mixer::getBeepChannelGains(int placement, int nchannels, std::vector<float> &gains)
+{
+  gains.assign(nchannels, 0.f);
+  if (nchannels <= 0)
+    return;
+
+  // WAVE channel order: L R C LFE (BL BR) (SL SR), the placements below leave the LFE out
+  if ((placement == kBeepCenter) && (nchannels >= 3))
+    gains[2] = 1.f;
+  else
+    if (((placement == kBeepCenter) || (placement == kBeepFrontLR)) && (nchannels >= 2))
+    {
+      gains[0] = 1.f; // phantom center for stereo
+      gains[1] = 1.f;
+    }
+    else
+      for (int j=0; j < nchannels; j++) // every channel, LFE included, as before placements
+        gains[j] = 1.f;
+}
 
 // returns a vector of level (linear gain) for the beeps signal
-int Mixer::computeBeepLevel(const float* buffer, const int nsamples,  const float samplerate, std::vector<float> &timestamps, std::vector<float> &beepLevel, float &percentile10)
+int Mixer::computeBeepLevel(const float** buffer, int nchannels, const std::vector<float> &weights, const int nsamples,  const float samplerate, std::vector<float> &timestamps, std::vector<float> &beepLevel, float &percentile10)
 {
   // estimate energy and dynamics curves
   std::vector<float> energy;
@@ -120,11 +212,17 @@ int Mixer::computeBeepLevel(const float* buffer, const int nsamples,  const floa
   // set frameTime  to 11.6ms
   float frametime = 512.f/samplerate; // 11.6ms default
   
-  computeEnergy(buffer, nsamples, samplerate, frametime, timestamps, energy);
+  {
+    ScopedTimer timer("energy");
+    computeEnergy(buffer, nchannels, weights, nsamples, samplerate, frametime, timestamps, energy);
+  }
   
   std::cout << "Progress MIX = " << 75 << std::endl;
   
-  computeDynamicsStability(energy, frametime, energyDB, stab, percentile10);
+  {
+    ScopedTimer timer("stability");
+    computeDynamicsStability(energy, frametime, energyDB, stab, percentile10);
+  }
 
   std::cout << "Progress MIX = " << 90 << std::endl;
   
@@ -146,6 +244,7 @@ int Mixer::computeBeepLevel(const float* buffer, const int nsamples,  const floa
   float level = 1.f;
   float levelDB = 0.f;
   
+  beepLevel.reserve(energyDB.size());
   for (int i = 0; i < (int)energyDB.size(); i++)
   {
     // scale range [-5..-40] to [maxLevelDB..maxLevelDB-20] dB
@@ -161,50 +260,76 @@ int Mixer::computeBeepLevel(const float* buffer, const int nsamples,  const floa
 }
 
 
-int Mixer::computeEnergy(const float *buffer, const int nsamples,  const float samplerate, float frameTime, std::vector<float> &timestamps, std::vector<float> &energy)
+// energy of one windowed frame, vectorized by the compiler
+static inline float windowedEnergy(const float *x, const float *w, int n)
+{
+  float en = 0.f;
+  for (int k=0; k<n; k++)
+    en += (x[k]*x[k])*w[k];
+  return en;
+}
+
+int Mixer::computeEnergy(const float **buffer, int nchannels, const std::vector<float> &weights, const int nsamples,  const float samplerate, float frameTime, std::vector<float> &timestamps, std::vector<float> &energy)
 { 
   int h = int(frameTime*samplerate + 0.5); // hop size
   int ws = 4*h; //int(2048*samplerate/44100.f); // win size
   ws = ws - (ws%2); // make it even
   std::vector<float> w;
-  w.reserve(nsamples);
-  energy.reserve(nsamples);
-  timestamps.reserve(nsamples);
+  w.reserve(ws+1);
   float area = hanning(ws+1, w);
   int hws = ws/2;
   
   int nFrames = int(nsamples/h)-2;  
+  energy.reserve(std::max(nFrames, 0));
+  timestamps.reserve(std::max(nFrames, 0));
   
-  int i,k;
-  for (i=0; i<nFrames; i++) {
-    
-    float current_progress_mix = ((float)i / (float)nFrames)*75.f; //from 0% to 75%
-    if (current_progress_mix > progress_mix + 5)
+  // channels that take part in the analysis, silent ones (LFE) are skipped
+  std::vector<int> active;
+  for (int j=0; j < nchannels; j++)
+    if (weights[j] > 0.f)
+      active.push_back(j);
+
+  Metrics::beginStage("analysis", nsamples, samplerate);
+
+  // frames are analyzed in slices, progress is reported between them (from 0% to 75%)
+  const int nslices = 15;
+  int i = 0;
+  for (int slice=1; slice<=nslices; slice++)
+  {
+    int lastFrame = (int)(((long)nFrames * slice) / nslices);
+    for (; i<lastFrame; i++)
+    {
+      // compute energy for one window frame
+      int b = h*i-hws;
+      int e = h*i+hws;
+      int start = b;
+      int end = e + 1;
+      if (b<1)
+        start = 0;
+      else
+        if (e>=nsamples)
+          end = nFrames;
+
+      // weighted sum of the channel energies in the same pass
+      float en = 0.f;
+      for (int a=0; a < (int)active.size(); a++)
+      {
+        int j = active[a];
+        if (end > start)
+          en += weights[j] * windowedEnergy(buffer[j] + start, &w[start-b], end-start);
+      }
+
+      // store values
+      timestamps.push_back(i * frameTime);
+      en /= area;
+      energy.push_back(en);
+    }
+    Metrics::setFrames(std::min((long)i * h, (long)nsamples));
+    if (slice < nslices) // 75% is reported by the caller
     {
-      progress_mix = current_progress_mix;
+      progress_mix = (75 * slice) / nslices;
       std::cout << "Progress MIX = " << progress_mix << std::endl;
     }
-
-    // compute energy for one window frame
-    int b = h*i-hws;
-    int e = h*i+hws;
-    float en = 0.f;
-    if (b<1)
-      for(k=0;k<=e;k++)
-        en += (buffer[k]*buffer[k])*w[k-b];
-    else
-      if (e>=nsamples)
-        for(k=b;k<nFrames;k++){
-          en += (buffer[k]*buffer[k])*w[k-b];
-        }
-      else
-        for(k=b;k<=e;k++)
-          en += (buffer[k]*buffer[k])*w[k-b];
-    
-    // store values
-    timestamps.push_back(i * frameTime);
-    en /= area;
-    energy.push_back(en);
   }
 
   return 0;
@@ -213,12 +338,16 @@ int Mixer::computeEnergy(const float *buffer, const int nsamples,  const float s
 
 // -------------------------------------------------------------------------------------------------
 // compute a dynamics stability measure from a input energy (linear) vector and outputs the energy in DB
-int Mixer::computeDynamicsStability(const std::vector<float> energy, float frameTime, std::vector<float> &energyDB, std::vector<float> &st, float &percentile10)
+int Mixer::computeDynamicsStability(const std::vector<float> &energy, float frameTime, std::vector<float> &energyDB, std::vector<float> &st, float &percentile10)
 {
   int nFr = energy.size();
   energyDB.clear();       // empty vector
   st.clear();             // empty vector
-  std::vector<float> ew;  // energy weight
+  std::vector<float> &ew = mScratch;  // energy weight
+  ew.clear();
+  energyDB.reserve(nFr);
+  st.reserve(nFr);
+  ew.reserve(nFr);
   
   float edB = 0;
   for (int i=0; i < nFr; ++i)
@@ -287,7 +416,8 @@ void Mixer::smooth(std::vector<float> &v,int window, bool useNonZero)
   //
   int i,k;
   int hw = int(window/2);
-  std::vector<float> v2 = v;
+  std::vector<float> &v2 = mScratch; // copy of the input, reuses the mixer storage
+  v2.assign(v.begin(), v.end());
   for(i=1; i<v.size()-1; i++)
   {
     int b = std::max(0,i-hw);
@@ -10,6 +10,8 @@
 //#include <stdio.h>
 
 #include <vector>
+
+#include "PeakLimiter.h"
 #include <math.h>
 
 
@@ -17,6 +19,11 @@
 #define kGlobalLevelMode 1
 #define kDynamicLevelMode 2
 
+// channels that receive the beeps (WAVE order L R C LFE ...), only kBeepAllChannels feeds the LFE
+#define kBeepAllChannels 0
+#define kBeepCenter 1     // C, phantom center (L and R) for stereo
+#define kBeepFrontLR 2    // L and R
+
 class Mixer{
 public:
   Mixer(){
@@ -30,6 +37,10 @@ public:
     // set default flags
     mMode = kDynamicLevelMode;
     mUseNormalize = true;
+    mBeepPlacement = kBeepAllChannels;
+    mUseLimiter = false;
+    mLimiterCeiling = -1.f;
+    mOutputGain = 1.f;
   };
 
   Mixer(int mode, float volumedb) {
@@ -42,19 +53,35 @@ public:
                          // set default flags
     mMode = mode;
     mUseNormalize = true;
+    mBeepPlacement = kBeepAllChannels;
+    mUseLimiter = false;
+    mLimiterCeiling = -1.f;
+    mOutputGain = 1.f;
 
     progress_mix = 0;
   };
   
   ~Mixer() {};
+  // bufferMix may be bufferPgm to mix in place
   int mix(const float** bufferPgm, const int nsamples, int nchannels, const float samplerate, const float* bufferBeeps, float** bufferMix);
-  int computeBeepLevel(const float* buffer, const int nsamples,  const float samplerate, std::vector<float> &timestamps, std::vector<float> &beepLevel, float &percentile10);
-  int computeEnergy(const float *buffer, const int nsamples,  const float samplerate, float frameTime, std::vector<float> &timestamps, std::vector<float> &energy);
-  int computeDynamicsStability(const std::vector<float> energy, float frameTime, std::vector<float> &energyDB, std::vector<float> &st, float &percentile10);
+  // mixes one block with the default levels (kDefaultMode), for streams whose length is not known
+  // bufferMix may be bufferPgm to mix in place. beginBlocks() must be called before the first block.
+  // returns the frames written to bufferMix: with the limiter the output lags the input by its
+  // latency, flushBlocks() writes the last frames at the end of the stream
+  void beginBlocks(int nchannels, const float samplerate);
+  int mixBlock(const float** bufferPgm, const int nsamples, int nchannels, const float* bufferBeeps, float** bufferMix);
+  int flushBlocks(float** bufferMix, long offset, int maxFrames);
+  // levels follow the program energy of the channels that receive the beeps, weighted by weights
+  int computeBeepLevel(const float** buffer, int nchannels, const std::vector<float> &weights, const int nsamples,  const float samplerate, std::vector<float> &timestamps, std::vector<float> &beepLevel, float &percentile10);
+  int computeEnergy(const float **buffer, int nchannels, const std::vector<float> &weights, const int nsamples,  const float samplerate, float frameTime, std::vector<float> &timestamps, std::vector<float> &energy);
+  int computeDynamicsStability(const std::vector<float> &energy, float frameTime, std::vector<float> &energyDB, std::vector<float> &st, float &percentile10);
   void smooth(std::vector<float> &v,int window, bool useNonZero);
   int computeLevels(const std::vector<float> energy, std::vector<float> &energyDB, std::vector<float> &st);
   
   float hanning(const int n, std::vector<float> &w);
+
+  // beep gain per channel (1 or 0) for a placement
+  static void getBeepChannelGains(int placement, int nchannels, std::vector<float> &gains);
   
   // set functions
   void setBeepLevel(float gainDB){ mDefaultBeepLevel = gainDB;};
@@ -62,7 +89,16 @@ public:
   void setProgramLevel(float gainDB){ mDefaultProgramLevel = gainDB;};
   void setSmoothTime(float time){ mSmoothTime = time;};
   void setMode(int val) {mMode = val;};
+  // normalization is not applied to bufferMix: mix() leaves the gain in getOutputGain()
+  // for the writer to apply while converting the samples
   void setUseNormalize(bool val) {mUseNormalize = val;};
+  float getOutputGain() {return mOutputGain;};
+  // upper bound of the mixBlock() peaks from the program and beeps peaks, lets blocks be
+  // normalized before they are mixed
+  float getBlockPeakBound(float programPeak, float beepsPeak);
+  void setBeepPlacement(int placement) {mBeepPlacement = placement; mBlockGains.clear();};
+  // true-peak limiter instead of hard clipping, ceiling in dBTP (<= 0)
+  void setLimiter(bool enabled, float ceilingDB) {mUseLimiter = enabled; mLimiterCeiling = ceilingDB;};
   
 private:
   float mDefaultBeepLevel;
@@ -72,8 +108,16 @@ private:
       // flags
   int mMode;
   bool mUseNormalize;
+  float mOutputGain;
+  int mBeepPlacement;
+  bool mUseLimiter;
+  float mLimiterCeiling;
+  PeakLimiter mLimiter;
 
   int progress_mix;
+
+  std::vector<float> mScratch; // analysis scratch, kept across calls to avoid reallocations
+  std::vector<float> mBlockGains; // beep gain per channel for mixBlock()
 };
 
 #endif /* Mixer_h */
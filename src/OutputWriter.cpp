@@ -0,0 +1,237 @@
+/*--------------------------------------------------------------------------------
+ OutputWriter.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "OutputWriter.h"
+
+#include "PcmConvert.h"
+#include "PlanarIO.h"
+#include "StageTimers.h"
+
+#include <string.h>
+
+#ifndef MIN
+#define MIN(a,b) ((a <= b) ? (a) : (b))
+#endif
+
+int OutputFormat::toSndfileFormat(int format)
+{
+  switch (format)
+  {
+  case kWav16: return SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+  case kWav24: return SF_FORMAT_WAV | SF_FORMAT_PCM_24;
+  case kWavFloat: return SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+  case kFlac: return SF_FORMAT_FLAC | SF_FORMAT_PCM_16;
+  case kOggVorbis: return SF_FORMAT_OGG | SF_FORMAT_VORBIS;
+  }
+  return 0;
+}
+
+int OutputFormat::toSampleFormat(int format)
+{
+  switch (format)
+  {
+  case kWav16: return PcmConvert::kPcm16;
+  case kWav24: return PcmConvert::kPcm24;
+  case kWavFloat: return PcmConvert::kFloat32;
+  }
+  return -1;
+}
+
+const char *OutputFormat::getName(int format)
+{
+  switch (format)
+  {
+  case kWav16: return "wav 16 bits";
+  case kWav24: return "wav 24 bits";
+  case kWavFloat: return "wav float";
+  case kFlac: return "flac";
+  case kOggVorbis: return "ogg vorbis";
+  }
+  return "unknown";
+}
+
+OutputWriter::OutputWriter(int blockFrames, int queueBlocks)
+{
+  mFile = NULL;
+  mChannels = 0;
+  mBlockFrames = blockFrames;
+  mPool.resize(queueBlocks);
+  mCurrent = NULL;
+  mClosing = false;
+  mError = false;
+  mFramesWritten = 0;
+  mGain = 1.f;
+  mSync = false;
+}
+
+OutputWriter::~OutputWriter()
+{
+  close();
+}
+
+int OutputWriter::open(const char *filename, int channels, int sampleRate, int format)
+{
+  close();
+
+  SF_INFO info;
+  memset(&info, 0, sizeof(info));
+  info.format = OutputFormat::toSndfileFormat(format);
+  info.channels = channels;
+  info.samplerate = sampleRate;
+  if ((info.format == 0) || !sf_format_check(&info))
+    return kNotSupported;
+
+  mFile = sf_open(filename, SFM_WRITE, &info);
+  if (!mFile)
+    return kCannotOpen;
+
+  mChannels = channels;
+  mFree.clear();
+  mQueue.clear();
+  for (int i = 0; i < (int)mPool.size(); i++)
+  {
+    mPool[i].data.resize(mBlockFrames * channels);
+    mPool[i].frames = 0;
+    mFree.push_back(&mPool[i]);
+  }
+  mCurrent = NULL;
+  mClosing = false;
+  mError = false;
+  mFramesWritten = 0;
+
+  mThread = std::thread(&OutputWriter::run, this);
+  return kOk;
+}
+
+OutputWriter::Block *OutputWriter::acquireBlock()
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  mFreed.wait(lock, [this] { return !mFree.empty(); });
+  Block *block = mFree.back();
+  mFree.pop_back();
+  block->frames = 0;
+  return block;
+}
+
+void OutputWriter::queueBlock(Block *block)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.push_back(block);
+  }
+  mQueued.notify_one();
+}
+
+int OutputWriter::write(const float *in, int nframes)
+{
+  if (!mFile || mError)
+    return 0;
+
+  int done = 0;
+  while (done < nframes)
+  {
+    if (!mCurrent)
+      mCurrent = acquireBlock();
+
+    int n = MIN(nframes - done, mBlockFrames - mCurrent->frames);
+    memcpy(&mCurrent->data[mCurrent->frames * mChannels], in + done * mChannels, n * mChannels * sizeof(float));
+    mCurrent->frames += n;
+    done += n;
+
+    if (mCurrent->frames == mBlockFrames)
+    {
+      queueBlock(mCurrent);
+      mCurrent = NULL;
+    }
+  }
+  return nframes;
+}
+
+int OutputWriter::writePlanar(const float *const *in, long offset, int nframes)
+{
+  if (!mFile || mError)
+    return 0;
+
+  int done = 0;
+  while (done < nframes)
+  {
+    if (!mCurrent)
+      mCurrent = acquireBlock();
+
+    int n = MIN(nframes - done, mBlockFrames - mCurrent->frames);
+    PlanarIO::interleave(in, offset + done, n, mChannels, &mCurrent->data[mCurrent->frames * mChannels]);
+    mCurrent->frames += n;
+    done += n;
+
+    if (mCurrent->frames == mBlockFrames)
+    {
+      queueBlock(mCurrent);
+      mCurrent = NULL;
+    }
+  }
+  return nframes;
+}
+
+void OutputWriter::run()
+{
+  while (true)
+  {
+    Block *block = NULL;
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mQueued.wait(lock, [this] { return !mQueue.empty() || mClosing; });
+      if (mQueue.empty())
+        return; // closing and nothing left
+      block = mQueue.front();
+      mQueue.pop_front();
+    }
+
+    // encoding runs outside the lock
+    ScopedTimer timer("write");
+    if (mGain != 1.f)
+    {
+      const int n = block->frames * mChannels;
+      for (int i = 0; i < n; i++)
+        block->data[i] *= mGain;
+    }
+    sf_count_t count = mError ? 0 : sf_writef_float(mFile, &block->data[0], block->frames);
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (count < block->frames)
+        mError = true;
+      else
+        mFramesWritten += count;
+      mFree.push_back(block);
+    }
+    mFreed.notify_one();
+  }
+}
+
+int OutputWriter::close()
+{
+  if (!mFile)
+    return kOk;
+
+  if (mCurrent && (mCurrent->frames > 0))
+    queueBlock(mCurrent);
+  mCurrent = NULL;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mClosing = true;
+  }
+  mQueued.notify_one();
+  if (mThread.joinable())
+    mThread.join();
+
+  if (mSync)
+    sf_write_sync(mFile);
+  sf_close(mFile);
+  mFile = NULL;
+
+  return mError ? kWriteError : kOk;
+}
@@ -0,0 +1,102 @@
+/*--------------------------------------------------------------------------------
+ OutputWriter.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef OutputWriter_h
+#define OutputWriter_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sndfile.h"
+
+// Output file formats, encoded by libsndfile (FLAC and Ogg Vorbis through the linked
+// libFLAC / libvorbisenc).
+namespace OutputFormat
+{
+  enum
+  {
+    kWav16 = 0,
+    kWav24 = 1,
+    kWavFloat = 2,
+    kFlac = 3,
+    kOggVorbis = 4,
+    kNumFormats
+  };
+
+  // libsndfile SF_FORMAT_* major | subtype, 0 if the format is unknown
+  int toSndfileFormat(int format);
+  // PcmConvert sample format of the WAV formats, -1 for the compressed ones
+  int toSampleFormat(int format);
+  const char *getName(int format);
+}
+
+// Writes interleaved frames to a sound file from a separate thread, so the caller keeps
+// mixing while the previous blocks are encoded.
+//
+// Frames are copied into fixed-size blocks taken from a pool of queueBlocks blocks. Full
+// blocks go through a bounded queue to the writer thread, which encodes them with
+// sf_writef_float and gives them back to the pool. When every block is waiting to be
+// encoded write() blocks, which bounds the memory used whatever the file length.
+class OutputWriter{
+public:
+  enum { kOk = 0, kCannotOpen = -1, kNotSupported = -2, kWriteError = -3 };
+
+  OutputWriter(int blockFrames = 4096, int queueBlocks = 8);
+  ~OutputWriter();
+
+  // creates the file and starts the writer thread
+  int open(const char *filename, int channels, int sampleRate, int format);
+
+  // queues nframes interleaved frames, returns nframes or 0 after a write error
+  int write(const float *in, int nframes);
+  // queues nframes frames of planar buffers starting at in[t] + offset
+  int writePlanar(const float *const *in, long offset, int nframes);
+  // gain applied by the writer thread just before encoding, set it before the first write
+  void setGain(float gain) { mGain = gain; };
+  // close() waits until the file is on the disk (sf_write_sync), off by default
+  void setSync(bool sync) { mSync = sync; };
+
+  // flushes the queued blocks, stops the thread and closes the file
+  // returns kOk, or kWriteError if some frames could not be encoded
+  int close();
+
+  long getFramesWritten() { return mFramesWritten; };
+
+private:
+  struct Block
+  {
+    std::vector<float> data;
+    int frames;
+  };
+
+  Block *acquireBlock();
+  void queueBlock(Block *block);
+  void run();
+
+  SNDFILE *mFile;
+  int mChannels;
+  int mBlockFrames;
+  std::vector<Block> mPool;
+  Block *mCurrent;                // block being filled by the caller
+
+  std::thread mThread;
+  std::mutex mMutex;
+  std::condition_variable mQueued;   // signals the writer thread
+  std::condition_variable mFreed;    // signals the caller
+  std::deque<Block*> mQueue;
+  std::vector<Block*> mFree;
+  bool mClosing;
+  std::atomic<bool> mError;        // read by the caller without the lock
+  long mFramesWritten;
+  float mGain;
+  bool mSync;
+};
+
+#endif /* OutputWriter_h */
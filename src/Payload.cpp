@@ -0,0 +1,61 @@
+/*--------------------------------------------------------------------------------
+ Payload.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "Payload.h"
+
+const char Payload::kEncodeTable[33] = "0123456789abcdefghijklmnopqrstuv";
+
+#define X -1
+const int8_t Payload::kDecodeTable[256] =
+{
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, X, X, X, X, X, X,           // '0'..'9'
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, // 'a'..'o'
+  25, 26, 27, 28, 29, 30, 31, X, X, X, X, X, X, X, X, X,    // 'p'..'v'
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X
+};
+#undef X
+
+bool Payload::fromString(const char *str, int size, Payload &payload)
+{
+  if (size < kNumChars)
+    return false;
+
+  uint64_t value = 0;
+  for (int i = 0; i < kNumChars; i++)
+  {
+    int v = charToVal(str[i]);
+    if (v < 0)
+      return false;
+    value = (value << kBitsPerChar) | (uint64_t)v;
+  }
+  payload = Payload(value);
+  return true;
+}
+
+int32_t Payload::packKey(const char *key)
+{
+  int32_t packed = 0;
+  for (int i = 0; i < kKeyChars; i++)
+  {
+    int v = charToVal(key[i]);
+    if (v < 0)
+      return -1;
+    packed = (packed << kBitsPerChar) | v;
+  }
+  return packed;
+}
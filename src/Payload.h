@@ -0,0 +1,69 @@
+/*--------------------------------------------------------------------------------
+ Payload.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef Payload_h
+#define Payload_h
+
+#include <stdint.h>
+
+// Audio mark payload: 5 character key followed by a 4 character timestamp (seconds),
+// every character being a base 32 digit in {0-9, a-v}.
+//
+// The 9 characters are packed 5 bits each into a 45 bit integer, most significant
+// character first, so the key takes the upper 25 bits and the timestamp the lower 20.
+// Strings are only built when the payload is handed to the BeepingCore API.
+class Payload{
+public:
+  enum
+  {
+    kBitsPerChar = 5,
+    kKeyChars = 5,
+    kTimestampChars = 4,
+    kNumChars = kKeyChars + kTimestampChars,
+    kTimestampBits = kTimestampChars * kBitsPerChar,
+    kKeyBits = kKeyChars * kBitsPerChar
+  };
+
+  Payload() { mValue = 0; };
+  explicit Payload(uint64_t value) { mValue = value & ((1ULL << (kKeyBits + kTimestampBits)) - 1); };
+  Payload(uint32_t key, uint32_t timestamp) {
+    mValue = ((uint64_t)(key & ((1u << kKeyBits) - 1)) << kTimestampBits) | (timestamp & ((1u << kTimestampBits) - 1));
+  };
+
+  uint64_t getValue() const { return mValue; };
+  uint32_t getKey() const { return (uint32_t)(mValue >> kTimestampBits); };
+  uint32_t getTimestamp() const { return (uint32_t)(mValue & ((1u << kTimestampBits) - 1)); };
+
+  // symbol (0..31) of character i, 0 being the first key character
+  int getSymbol(int i) const { return (int)(mValue >> (kBitsPerChar * (kNumChars - 1 - i))) & 31; };
+
+  // writes kNumChars characters plus a terminating null
+  void toString(char *str) const {
+    for (int i = 0; i < kNumChars; i++)
+      str[i] = valToChar(getSymbol(i));
+    str[kNumChars] = '\0';
+  };
+
+  // parses the first kNumChars characters, returns false if any of them is not valid
+  static bool fromString(const char *str, int size, Payload &payload);
+
+  // packs a kKeyChars characters key, returns -1 if not valid
+  static int32_t packKey(const char *key);
+
+  static int charToVal(char c) { return kDecodeTable[(unsigned char)c]; };
+  static char valToChar(int val) { return kEncodeTable[val & 31]; };
+
+  bool operator==(const Payload &other) const { return mValue == other.mValue; };
+  bool operator!=(const Payload &other) const { return mValue != other.mValue; };
+
+private:
+  uint64_t mValue;
+
+  static const char kEncodeTable[33];
+  static const int8_t kDecodeTable[256];
+};
+
+#endif /* Payload_h */
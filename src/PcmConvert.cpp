@@ -0,0 +1,162 @@
+/*--------------------------------------------------------------------------------
+ PcmConvert.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "PcmConvert.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PCMCONVERT_SSE2
+#endif
+
+#define kWaveFormatPcm 1
+#define kWaveFormatFloat 3
+#define kWaveFormatExtensible 0xFFFE
+
+using namespace PcmConvert;
+
+int PcmConvert::bytesPerSample(int sampleFormat)
+{
+  return (sampleFormat == PcmConvert::kPcm16) ? 2 : (sampleFormat == PcmConvert::kPcm24) ? 3 : 4;
+}
+
+static void pcm16ToFloat(const int16_t *in, int n, float *out)
+{
+  const float scale = 1.f / 32768.f;
+  int i = 0;
+#if defined(PCMCONVERT_SSE2)
+  const __m128 vscale = _mm_set1_ps(scale);
+  for (; i + 8 <= n; i += 8)
+  {
+    __m128i s = _mm_loadu_si128((const __m128i *)(in + i));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+  }
+#endif
+  for (; i < n; i++)
+    out[i] = in[i] * scale;
+}
+
+static void floatToPcm16(const float *in, int n, int16_t *out, float gain)
+{
+  const float scale = 32767.f * gain;
+  int i = 0;
+#if defined(PCMCONVERT_SSE2)
+  const __m128 vscale = _mm_set1_ps(scale);
+  for (; i + 8 <= n; i += 8)
+  {
+    // cvtps rounds to nearest, packs saturates
+    __m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), vscale));
+    __m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), vscale));
+    _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; i < n; i++)
+  {
+    float v = in[i] * scale;
+    v = (v > 32767.f) ? 32767.f : (v < -32768.f) ? -32768.f : v;
+    out[i] = (int16_t)lrintf(v);
+  }
+}
+
+static void pcm24ToFloat(const uint8_t *in, int n, float *out)
+{
+  const float scale = 1.f / 8388608.f;
+  for (int i = 0; i < n; i++)
+  {
+    int32_t v = (int32_t)(((uint32_t)in[3 * i] << 8) | ((uint32_t)in[3 * i + 1] << 16) | ((uint32_t)in[3 * i + 2] << 24)) >> 8;
+    out[i] = v * scale;
+  }
+}
+
+static void floatToPcm24(const float *in, int n, uint8_t *out, float gain)
+{
+  const float scale = 8388607.f * gain;
+  for (int i = 0; i < n; i++)
+  {
+    float v = in[i] * scale;
+    v = (v > 8388607.f) ? 8388607.f : (v < -8388608.f) ? -8388608.f : v;
+    int32_t s = (int32_t)lrintf(v);
+    out[3 * i] = (uint8_t)s;
+    out[3 * i + 1] = (uint8_t)(s >> 8);
+    out[3 * i + 2] = (uint8_t)(s >> 16);
+  }
+}
+
+void PcmConvert::toFloat(const uint8_t *in, int sampleFormat, int nsamples, float *out)
+{
+  if (sampleFormat == kPcm16)
+    pcm16ToFloat((const int16_t *)in, nsamples, out);
+  else if (sampleFormat == kPcm24)
+    pcm24ToFloat(in, nsamples, out);
+  else
+    memcpy(out, in, nsamples * sizeof(float));
+}
+
+void PcmConvert::fromFloat(const float *in, int sampleFormat, int nsamples, uint8_t *out, float gain)
+{
+  if (sampleFormat == kPcm16)
+    floatToPcm16(in, nsamples, (int16_t *)out, gain);
+  else if (sampleFormat == kPcm24)
+    floatToPcm24(in, nsamples, out, gain);
+  else if (gain == 1.f)
+    memcpy(out, in, nsamples * sizeof(float));
+  else
+  {
+    float *dst = (float *)out;
+    for (int i = 0; i < nsamples; i++)
+      dst[i] = in[i] * gain;
+  }
+}
+
+int PcmConvert::parseFormatChunk(const uint8_t *chunk, long chunkSize, int &channels, int &sampleRate)
+{
+  if (chunkSize < 16)
+    return -1;
+
+  int formatTag = readU16(chunk);
+  channels = readU16(chunk + 2);
+  sampleRate = (int)readU32(chunk + 4);
+  int blockAlign = readU16(chunk + 12);
+  int bitsPerSample = readU16(chunk + 14);
+  if ((formatTag == kWaveFormatExtensible) && (chunkSize >= 26))
+    formatTag = readU16(chunk + 24); // first bytes of the sub format GUID
+
+  int sampleFormat = -1;
+  if ((formatTag == kWaveFormatPcm) && (bitsPerSample == 16))
+    sampleFormat = kPcm16;
+  else if ((formatTag == kWaveFormatPcm) && (bitsPerSample == 24))
+    sampleFormat = kPcm24;
+  else if ((formatTag == kWaveFormatFloat) && (bitsPerSample == 32))
+    sampleFormat = kFloat32;
+
+  if ((sampleFormat < 0) || (channels <= 0) || (blockAlign != channels * bytesPerSample(sampleFormat)))
+    return -1;
+  return sampleFormat;
+}
+
+void PcmConvert::writeWavHeader(uint8_t *h, int channels, int sampleRate, int sampleFormat, uint32_t dataSize)
+{
+  int sampleBytes = bytesPerSample(sampleFormat);
+  uint32_t riffSize = (dataSize == 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)(kWavHeaderSize - 8 + dataSize + (dataSize & 1));
+  memcpy(h, "RIFF", 4);
+  writeU32(h + 4, riffSize);
+  memcpy(h + 8, "WAVE", 4);
+  memcpy(h + 12, "fmt ", 4);
+  writeU32(h + 16, 16);
+  writeU16(h + 20, (sampleFormat == kFloat32) ? kWaveFormatFloat : kWaveFormatPcm);
+  writeU16(h + 22, (uint16_t)channels);
+  writeU32(h + 24, (uint32_t)sampleRate);
+  writeU32(h + 28, (uint32_t)(sampleRate * channels * sampleBytes));
+  writeU16(h + 32, (uint16_t)(channels * sampleBytes));
+  writeU16(h + 34, (uint16_t)(8 * sampleBytes));
+  memcpy(h + 36, "data", 4);
+  writeU32(h + 40, dataSize);
+}
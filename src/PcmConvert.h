@@ -0,0 +1,38 @@
+/*--------------------------------------------------------------------------------
+ PcmConvert.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef PcmConvert_h
+#define PcmConvert_h
+
+#include <stdint.h>
+
+// Sample conversion between little endian PCM and float, with the libsndfile scaling
+// (ints are read as x / 2^(bits-1) and written as x * (2^(bits-1) - 1), saturated),
+// and the WAVE header fields shared by the mapped and streamed readers/writers.
+namespace PcmConvert
+{
+  enum SampleFormat { kPcm16 = 0, kPcm24 = 1, kFloat32 = 2 };
+  enum { kWavHeaderSize = 44 };
+
+  int bytesPerSample(int sampleFormat);
+
+  void toFloat(const uint8_t *in, int sampleFormat, int nsamples, float *out);
+  // gain is applied within the conversion (deferred normalization)
+  void fromFloat(const float *in, int sampleFormat, int nsamples, uint8_t *out, float gain = 1.f);
+
+  // parses the body of a "fmt " chunk, returns the sample format or -1 if it is not supported
+  int parseFormatChunk(const uint8_t *chunk, long chunkSize, int &channels, int &sampleRate);
+
+  // writes a canonical 44 byte header, dataSize 0xFFFFFFFF for streams of unknown length
+  void writeWavHeader(uint8_t *header, int channels, int sampleRate, int sampleFormat, uint32_t dataSize);
+
+  inline uint16_t readU16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+  inline uint32_t readU32(const uint8_t *p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+  inline void writeU16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+  inline void writeU32(uint8_t *p, uint32_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24); }
+}
+
+#endif /* PcmConvert_h */
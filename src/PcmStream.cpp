@@ -0,0 +1,148 @@
+/*--------------------------------------------------------------------------------
+ PcmStream.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "PcmStream.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+using namespace PcmConvert;
+
+long PcmStreamReader::readBytes(uint8_t *dst, long size)
+{
+  long done = 0;
+  while (done < size)
+  {
+    ssize_t n = ::read(mFd, dst + done, size - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  return done;
+}
+
+bool PcmStreamReader::skipBytes(long size)
+{
+  // through a fixed scratch buffer, the size comes from the stream and is not trusted
+  uint8_t scratch[4096];
+  while (size > 0)
+  {
+    long n = (size < (long)sizeof(scratch)) ? size : (long)sizeof(scratch);
+    if (readBytes(scratch, n) != n)
+      return false;
+    size -= n;
+  }
+  return true;
+}
+
+int PcmStreamReader::open(bool raw, int channels, int sampleRate)
+{
+  mRemaining = -1;
+
+  if (raw)
+  {
+    mChannels = channels;
+    mSampleRate = sampleRate;
+    mSampleFormat = kPcm16;
+    return (channels > 0) ? 0 : -1;
+  }
+
+  uint8_t riff[12];
+  if ((readBytes(riff, 12) != 12) || (memcmp(riff, "RIFF", 4) != 0) || (memcmp(riff + 8, "WAVE", 4) != 0))
+    return -1;
+
+  // chunks are skipped by reading them, a pipe cannot seek
+  int sampleFormat = -1;
+  while (true)
+  {
+    uint8_t chunkHeader[8];
+    if (readBytes(chunkHeader, 8) != 8)
+      return -1;
+    long chunkSize = (long)readU32(chunkHeader + 4);
+
+    if (memcmp(chunkHeader, "data", 4) == 0)
+    {
+      // streamed WAVE files leave the size at 0 or 0xFFFFFFFF
+      mRemaining = ((chunkSize == 0) || (chunkSize == 0xFFFFFFFFL)) ? -1 : chunkSize;
+      break;
+    }
+
+    const long paddedSize = chunkSize + (chunkSize & 1);
+    if (memcmp(chunkHeader, "fmt ", 4) == 0)
+    {
+      if (chunkSize > kMaxFormatChunk)
+        return -1;
+      uint8_t format[kMaxFormatChunk + 1];
+      if (readBytes(format, paddedSize) != paddedSize)
+        return -1;
+      sampleFormat = parseFormatChunk(format, chunkSize, mChannels, mSampleRate);
+    }
+    else if (!skipBytes(paddedSize))
+      return -1;
+  }
+
+  if (sampleFormat < 0)
+    return -1;
+  mSampleFormat = sampleFormat;
+  return 0;
+}
+
+int PcmStreamReader::read(float *out, int nframes)
+{
+  const int frameBytes = mChannels * bytesPerSample(mSampleFormat);
+  long size = (long)nframes * frameBytes;
+  if ((mRemaining >= 0) && (size > mRemaining))
+    size = mRemaining - (mRemaining % frameBytes);
+  if (size <= 0)
+    return 0;
+
+  mBlock.resize(size);
+  long got = readBytes(mBlock.data(), size);
+  int frames = (int)(got / frameBytes); // a truncated last frame is dropped
+  if (mRemaining >= 0)
+    mRemaining -= got;
+
+  toFloat(mBlock.data(), mSampleFormat, frames * mChannels, out);
+  return frames;
+}
+
+long PcmStreamWriter::writeBytes(const uint8_t *src, long size)
+{
+  long done = 0;
+  while (done < size)
+  {
+    ssize_t n = ::write(mFd, src + done, size - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  return done;
+}
+
+int PcmStreamWriter::open(bool raw, int channels, int sampleRate, int sampleFormat)
+{
+  mChannels = channels;
+  mSampleFormat = sampleFormat;
+  if (raw)
+    return 0;
+
+  uint8_t header[kWavHeaderSize];
+  writeWavHeader(header, channels, sampleRate, sampleFormat, 0xFFFFFFFFu);
+  return (writeBytes(header, kWavHeaderSize) == kWavHeaderSize) ? 0 : -1;
+}
+
+int PcmStreamWriter::write(const float *in, int nframes)
+{
+  const int frameBytes = mChannels * bytesPerSample(mSampleFormat);
+  mBlock.resize((size_t)nframes * frameBytes);
+  fromFloat(in, mSampleFormat, nframes * mChannels, mBlock.data());
+  return (int)(writeBytes(mBlock.data(), (long)mBlock.size()) / frameBytes);
+}
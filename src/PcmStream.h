@@ -0,0 +1,72 @@
+/*--------------------------------------------------------------------------------
+ PcmStream.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef PcmStream_h
+#define PcmStream_h
+
+#include <stdint.h>
+#include <vector>
+
+#include "PcmConvert.h"
+
+// Sequential PCM over a file descriptor (stdin/stdout in pipe mode), for streams that
+// cannot seek and whose length is not known in advance.
+//
+// The reader accepts a WAVE stream (16 bit, 24 bit or float, the data size may be unset)
+// or headerless 16 bit PCM with the rate and channels given by the caller. The writer
+// emits a WAVE header with the data size left at 0xFFFFFFFF, or headerless PCM.
+class PcmStreamReader{
+public:
+  PcmStreamReader(int fd) { mFd = fd; mChannels = 0; mSampleRate = 0; mSampleFormat = PcmConvert::kPcm16; mRemaining = -1; };
+  ~PcmStreamReader() {};
+
+  // raw: headerless s16le with channels/sampleRate, otherwise the WAVE header is parsed
+  // returns 0 on success, -1 if the stream is not supported
+  int open(bool raw, int channels, int sampleRate);
+
+  // reads up to nframes interleaved frames, returns the number of frames read, 0 at the end
+  int read(float *out, int nframes);
+
+  int getChannels() { return mChannels; };
+  int getSampleRate() { return mSampleRate; };
+
+private:
+  long readBytes(uint8_t *dst, long size);
+  // reads and drops size bytes, returns false if the stream ends first
+  bool skipBytes(long size);
+
+  // WAVE_FORMAT_EXTENSIBLE takes 40 bytes, a longer fmt chunk is not a PCM stream
+  enum { kMaxFormatChunk = 64 };
+
+  int mFd;
+  int mChannels;
+  int mSampleRate;
+  int mSampleFormat;
+  long mRemaining;                // bytes left in the data chunk, -1 if unknown
+  std::vector<uint8_t> mBlock;
+};
+
+class PcmStreamWriter{
+public:
+  PcmStreamWriter(int fd) { mFd = fd; mChannels = 0; mSampleFormat = PcmConvert::kPcm16; };
+  ~PcmStreamWriter() {};
+
+  // writes the header unless raw, returns 0 on success, -1 on write error
+  int open(bool raw, int channels, int sampleRate, int sampleFormat);
+
+  // returns the number of frames written, less than nframes on write error
+  int write(const float *in, int nframes);
+
+private:
+  long writeBytes(const uint8_t *src, long size);
+
+  int mFd;
+  int mChannels;
+  int mSampleFormat;
+  std::vector<uint8_t> mBlock;
+};
+
+#endif /* PcmStream_h */
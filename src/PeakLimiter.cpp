@@ -0,0 +1,238 @@
+/*--------------------------------------------------------------------------------
+ PeakLimiter.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "PeakLimiter.h"
+
+#include <math.h>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846264338327950288
+#endif
+
+PeakLimiter::PeakLimiter()
+{
+  mChannels = 0;
+  mSampleRate = 44100.f;
+  mCeiling = 1.f;
+  mReleaseCoef = 0.f;
+  mFactor = 1;
+  mTapsPerPhase = 0;
+  mHistPos = 0;
+  mLatency = 0;
+  mDelayPos = 0;
+  mHoldFrames = 1;
+  mHoldHead = 0;
+  mHoldCount = 0;
+  mAverageFrames = 1;
+  mAveragePos = 0;
+  mAverageSum = 0.0;
+  mEnvelope = 1.f;
+  mMinGain = 1.f;
+  mFrames = 0;
+  mInCount = 0;
+  mOutCount = 0;
+  mSkip = 0;
+}
+
+int PeakLimiter::configure(int nchannels, float samplerate, float ceilingDB, float lookaheadMs, float releaseMs)
+{
+  if ((nchannels <= 0) || (samplerate <= 0.f) || (ceilingDB > 0.f) || (lookaheadMs < 0.f) || (releaseMs <= 0.f))
+    return -1;
+
+  mChannels = nchannels;
+  mSampleRate = samplerate;
+  mCeiling = powf(10.f, ceilingDB / 20.f);
+  mReleaseCoef = expf(-1.f / (releaseMs * 0.001f * samplerate));
+
+  // same oversampling as the ebur128 true peak
+  mFactor = (samplerate < 96000.f) ? 4 : ((samplerate < 192000.f) ? 2 : 1);
+  int interpDelay = 0;
+  if (mFactor > 1)
+  {
+    const int taps = 49;
+    mTapsPerPhase = (taps + mFactor - 1) / mFactor;
+    interpDelay = (taps - 1) / 2 / mFactor; // the center tap is on phase 0
+    mPhases.assign((size_t)mFactor * mTapsPerPhase, 0.f);
+    for (int p = 0; p < mFactor; p++)
+      for (int k = 0; k < mTapsPerPhase; k++)
+      {
+        int j = p + (mTapsPerPhase - 1 - k) * mFactor;
+        if (j >= taps)
+          continue;
+        double m = (double)j - (double)(taps - 1) / 2.0;
+        double c = (m == 0.0) ? 1.0 : sin(m * M_PI / mFactor) / (m * M_PI / mFactor);
+        c *= 0.5 * (1 - cos(2 * M_PI * j / (taps - 1)));
+        mPhases[p * mTapsPerPhase + k] = (float)c;
+      }
+  }
+  else
+  {
+    mTapsPerPhase = 0;
+    mPhases.clear();
+  }
+
+  // the hold covers one more frame than the look-ahead so the peaks between two
+  // samples get the gain of both
+  int lookahead = (int)(lookaheadMs * 0.001f * samplerate + 0.5f);
+  mHoldFrames = lookahead + 2;
+  mAverageFrames = lookahead + 1;
+  mLatency = interpDelay + lookahead;
+
+  mHist.assign((size_t)mChannels * 2 * mTapsPerPhase, 0.f);
+  mDelay.assign((size_t)mChannels * (mLatency + 1), 0.f);
+  mHoldValue.assign(mHoldFrames, 1.f);
+  mHoldIndex.assign(mHoldFrames, 0);
+  mAverage.assign(mAverageFrames, 1.f);
+  mFrame.assign(mChannels, 0.f);
+
+  reset();
+
+  return 0;
+}
+
+void PeakLimiter::reset()
+{
+  std::fill(mHist.begin(), mHist.end(), 0.f);
+  std::fill(mDelay.begin(), mDelay.end(), 0.f);
+  std::fill(mAverage.begin(), mAverage.end(), 1.f);
+  mHistPos = 0;
+  mDelayPos = 0;
+  mHoldHead = 0;
+  mHoldCount = 0;
+  mAveragePos = 0;
+  mAverageSum = (double)mAverageFrames;
+  mEnvelope = 1.f;
+  mMinGain = 1.f;
+  mFrames = 0;
+  mInCount = 0;
+  mOutCount = 0;
+  mSkip = mLatency;
+}
+
+float PeakLimiter::getMaxReductionDB()
+{
+  return 20.f * log10f(mMinGain);
+}
+
+float PeakLimiter::truePeak(int t, float x)
+{
+  if (mFactor == 1)
+    return fabsf(x);
+
+  const int T = mTapsPerPhase;
+  float *hist = &mHist[(size_t)t * 2 * T];
+  hist[mHistPos] = x;
+  hist[mHistPos + T] = x;
+
+  // window of the last T samples, oldest first
+  const int pos = (mHistPos + 1 == T) ? 0 : mHistPos + 1;
+  const float *window = hist + pos;
+  float peak = 0.f;
+  for (int p = 0; p < mFactor; p++)
+  {
+    const float *phase = &mPhases[p * T];
+    float y = 0.f;
+    for (int k = 0; k < T; k++)
+      y += phase[k] * window[k];
+    peak = std::max(peak, fabsf(y));
+  }
+  return peak;
+}
+
+bool PeakLimiter::processFrame(float *frame)
+{
+  // linked detection, the loudest channel sets the gain of all of them
+  float peak = 0.f;
+  for (int t = 0; t < mChannels; t++)
+    peak = std::max(peak, truePeak(t, frame[t]));
+  if (mTapsPerPhase > 0)
+    mHistPos = (mHistPos + 1 == mTapsPerPhase) ? 0 : mHistPos + 1;
+
+  float required = (peak > mCeiling) ? mCeiling / peak : 1.f;
+
+  // minimum over the hold window
+  if ((mHoldCount > 0) && (mHoldIndex[mHoldHead] <= mFrames - mHoldFrames))
+  {
+    mHoldHead = (mHoldHead + 1) % mHoldFrames;
+    mHoldCount--;
+  }
+  while ((mHoldCount > 0) && (mHoldValue[(mHoldHead + mHoldCount - 1) % mHoldFrames] >= required))
+    mHoldCount--;
+  int tail = (mHoldHead + mHoldCount) % mHoldFrames;
+  mHoldValue[tail] = required;
+  mHoldIndex[tail] = mFrames;
+  mHoldCount++;
+  float held = mHoldValue[mHoldHead];
+  mFrames++;
+
+  // instant attack (the average does the ramp), exponential release
+  if (held < mEnvelope)
+    mEnvelope = held;
+  else
+    mEnvelope = held + (mEnvelope - held) * mReleaseCoef;
+
+  mAverageSum += mEnvelope - mAverage[mAveragePos];
+  mAverage[mAveragePos] = mEnvelope;
+  mAveragePos = (mAveragePos + 1 == mAverageFrames) ? 0 : mAveragePos + 1;
+  float gain = std::min(1.f, (float)(mAverageSum / mAverageFrames));
+
+  // delay line, the oldest frame comes out
+  const int size = mLatency + 1;
+  const int readPos = (mDelayPos + 1 == size) ? 0 : mDelayPos + 1;
+  for (int t = 0; t < mChannels; t++)
+  {
+    float *delay = &mDelay[(size_t)t * size];
+    delay[mDelayPos] = frame[t];
+    frame[t] = delay[readPos] * gain;
+  }
+  mDelayPos = readPos;
+
+  if (mSkip > 0)
+  {
+    mSkip--;
+    return false;
+  }
+  mMinGain = std::min(mMinGain, gain);
+  return true;
+}
+
+int PeakLimiter::process(const float *const *in, long inOffset, int nframes, float **out, long outOffset)
+{
+  int nout = 0;
+  for (int i = 0; i < nframes; i++)
+  {
+    for (int t = 0; t < mChannels; t++)
+      mFrame[t] = in[t][inOffset + i];
+    if (processFrame(&mFrame[0]))
+    {
+      for (int t = 0; t < mChannels; t++)
+        out[t][outOffset + nout] = mFrame[t];
+      nout++;
+    }
+  }
+  mInCount += nframes;
+  mOutCount += nout;
+  return nout;
+}
+
+int PeakLimiter::flush(float **out, long outOffset, int maxFrames)
+{
+  // push silence until the held back frames are out
+  int nout = 0;
+  while ((nout < maxFrames) && (mOutCount < mInCount))
+  {
+    std::fill(mFrame.begin(), mFrame.end(), 0.f);
+    if (processFrame(&mFrame[0]))
+    {
+      for (int t = 0; t < mChannels; t++)
+        out[t][outOffset + nout] = mFrame[t];
+      nout++;
+      mOutCount++;
+    }
+  }
+  return nout;
+}
@@ -0,0 +1,90 @@
+/*--------------------------------------------------------------------------------
+ PeakLimiter.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef PeakLimiter_h
+#define PeakLimiter_h
+
+#include <vector>
+
+// Look-ahead limiter with a true-peak ceiling, linked over all channels.
+//
+// Peaks are measured on the signal oversampled with the same interpolator as the
+// ebur128 true peak (49 taps Hann windowed sinc, x4 below 96 kHz, x2 below 192 kHz).
+// The gain needed at each peak is held over the look-ahead window and smoothed by a
+// moving average of the same length, so the gain is already down when the peak leaves
+// the delay line, then it recovers with the release time. No sample is clipped.
+//
+// The output is the input delayed by getLatency() frames: process() holds back the first
+// getLatency() frames and flush() writes them at the end, so n input frames give n output
+// frames in total, aligned with the input.
+class PeakLimiter{
+public:
+  PeakLimiter();
+  ~PeakLimiter() {};
+
+  // returns 0 on success, -1 on invalid parameters
+  int configure(int nchannels, float samplerate, float ceilingDB = -1.f, float lookaheadMs = 1.5f, float releaseMs = 50.f);
+  void reset();
+
+  // reads nframes from in[t] + inOffset and writes the limited frames ready so far to
+  // out[t] + outOffset, returns the number of frames written.
+  // out may be in with outOffset <= inOffset: a frame is written after the input frame at the same
+  // position has been read.
+  int process(const float *const *in, long inOffset, int nframes, float **out, long outOffset);
+  // writes at most maxFrames of the frames still held back, returns the number written
+  int flush(float **out, long outOffset, int maxFrames);
+
+  int getLatency() { return mLatency; };
+  int getPendingFrames() { return (int)(mInCount - mOutCount); };
+  float getCeiling() { return mCeiling; };
+  // lowest gain applied since reset(), in dB
+  float getMaxReductionDB();
+
+private:
+  // limits one frame read from frame[t], returns true and fills frame[t] when a delayed frame is out
+  bool processFrame(float *frame);
+  float truePeak(int t, float x);
+
+  int mChannels;
+  float mSampleRate;
+  float mCeiling;            // linear
+  float mReleaseCoef;
+
+  // true peak interpolator
+  int mFactor;
+  int mTapsPerPhase;
+  std::vector<float> mPhases;  // mFactor phases, each stored time-reversed
+  std::vector<float> mHist;    // per channel, stored twice so that every window is contiguous
+  int mHistPos;
+
+  // audio delay line, mLatency + 1 frames per channel
+  int mLatency;
+  std::vector<float> mDelay;
+  int mDelayPos;
+
+  // running minimum of the required gain over the hold window (monotonic queue)
+  int mHoldFrames;
+  std::vector<float> mHoldValue;
+  std::vector<long> mHoldIndex;
+  int mHoldHead;
+  int mHoldCount;
+
+  // moving average of the envelope
+  int mAverageFrames;
+  std::vector<float> mAverage;
+  int mAveragePos;
+  double mAverageSum;
+  float mEnvelope;
+
+  std::vector<float> mFrame;
+  float mMinGain;
+  long mFrames;              // frames through processFrame(), flush included
+  long mInCount;
+  long mOutCount;
+  long mSkip;                // frames still to hold back
+};
+
+#endif /* PeakLimiter_h */
@@ -0,0 +1,112 @@
+/*--------------------------------------------------------------------------------
+ PlanarIO.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "PlanarIO.h"
+
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define PLANARIO_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PLANARIO_NEON
+#endif
+
+static void deinterleaveStereo(const float *in, int nframes, float *left, float *right)
+{
+  int i = 0;
+#if defined(PLANARIO_SSE)
+  for (; i + 4 <= nframes; i += 4)
+  {
+    __m128 a = _mm_loadu_ps(in + 2 * i);     // l0 r0 l1 r1
+    __m128 b = _mm_loadu_ps(in + 2 * i + 4); // l2 r2 l3 r3
+    _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+#elif defined(PLANARIO_NEON)
+  for (; i + 4 <= nframes; i += 4)
+  {
+    float32x4x2_t lr = vld2q_f32(in + 2 * i);
+    vst1q_f32(left + i, lr.val[0]);
+    vst1q_f32(right + i, lr.val[1]);
+  }
+#endif
+  for (; i < nframes; i++)
+  {
+    left[i] = in[2 * i];
+    right[i] = in[2 * i + 1];
+  }
+}
+
+static void interleaveStereo(const float *left, const float *right, int nframes, float *out)
+{
+  int i = 0;
+#if defined(PLANARIO_SSE)
+  for (; i + 4 <= nframes; i += 4)
+  {
+    __m128 l = _mm_loadu_ps(left + i);
+    __m128 r = _mm_loadu_ps(right + i);
+    _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+  }
+#elif defined(PLANARIO_NEON)
+  for (; i + 4 <= nframes; i += 4)
+  {
+    float32x4x2_t lr;
+    lr.val[0] = vld1q_f32(left + i);
+    lr.val[1] = vld1q_f32(right + i);
+    vst2q_f32(out + 2 * i, lr);
+  }
+#endif
+  for (; i < nframes; i++)
+  {
+    out[2 * i] = left[i];
+    out[2 * i + 1] = right[i];
+  }
+}
+
+void PlanarIO::deinterleave(const float *in, int nframes, int nchannels, float **out, long offset)
+{
+  if (nchannels == 1)
+  {
+    memcpy(out[0] + offset, in, nframes * sizeof(float));
+  }
+  else if (nchannels == 2)
+  {
+    deinterleaveStereo(in, nframes, out[0] + offset, out[1] + offset);
+  }
+  else
+  {
+    for (int t = 0; t < nchannels; t++)
+    {
+      float *channel = out[t] + offset;
+      for (int i = 0; i < nframes; i++)
+        channel[i] = in[i * nchannels + t];
+    }
+  }
+}
+
+void PlanarIO::interleave(const float *const *in, long offset, int nframes, int nchannels, float *out)
+{
+  if (nchannels == 1)
+  {
+    memcpy(out, in[0] + offset, nframes * sizeof(float));
+  }
+  else if (nchannels == 2)
+  {
+    interleaveStereo(in[0] + offset, in[1] + offset, nframes, out);
+  }
+  else
+  {
+    for (int t = 0; t < nchannels; t++)
+    {
+      const float *channel = in[t] + offset;
+      for (int i = 0; i < nframes; i++)
+        out[i * nchannels + t] = channel[i];
+    }
+  }
+}
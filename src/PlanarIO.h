@@ -0,0 +1,22 @@
+/*--------------------------------------------------------------------------------
+ PlanarIO.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef PlanarIO_h
+#define PlanarIO_h
+
+// Conversion between the interleaved frames used by libsndfile and the planar
+// (one buffer per channel) layout used by the Mixer. Mono and stereo have SSE/NEON
+// kernels, other channel counts use a scalar loop.
+namespace PlanarIO
+{
+  // in: nframes interleaved frames, out[t] + offset: first sample written for channel t
+  void deinterleave(const float *in, int nframes, int nchannels, float **out, long offset);
+
+  // in[t] + offset: first sample read for channel t, out: nframes interleaved frames
+  void interleave(const float *const *in, long offset, int nframes, int nchannels, float *out);
+}
+
+#endif /* PlanarIO_h */
@@ -0,0 +1,240 @@
+/*--------------------------------------------------------------------------------
+ RSCodec.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef RSCodec_h
+#define RSCodec_h
+
+#include <stdint.h>
+#include <string.h>
+
+// Table-driven Reed-Solomon codec over GF(2^MM) correcting up to TT symbol errors.
+//
+// The code is shortened to MSG_LEN message symbols, so a codeword has
+// MSG_LEN + 2*TT symbols laid out as the message followed by the parity.
+// POLY is the primitive polynomial of the field (bit i = coefficient of x^i) and
+// the generator polynomial has roots alpha^1 .. alpha^(2*TT).
+//
+// Symbols are stored in uint8_t, so MM must be <= 8. The batch functions work on
+// caller-provided arrays of count consecutive messages / codewords and do not allocate.
+template <int MM, int TT, int MSG_LEN, int POLY>
+class RSCodec{
+public:
+  enum
+  {
+    kNN = (1 << MM) - 1,             // full codeword length
+    kNumParity = 2 * TT,
+    kKK = kNN - kNumParity,          // full message length
+    kMessageLen = MSG_LEN,
+    kCodeLen = MSG_LEN + 2 * TT,
+    kA0 = kNN                        // log of zero
+  };
+
+  RSCodec() {
+    generateGaloisField();
+    generatePoly();
+  };
+
+  ~RSCodec() {};
+
+  // writes count codewords of kCodeLen symbols for count messages of kMessageLen symbols
+  void encode(const uint8_t *messages, int count, uint8_t *codes) const {
+    for (int n = 0; n < count; n++)
+      encodeOne(messages + n * kMessageLen, codes + n * kCodeLen);
+  };
+
+  // corrects count codewords and writes their messages. status (optional) receives,
+  // per codeword, the number of corrected symbols or -1 if it could not be corrected
+  // (the message is then copied uncorrected). returns the number of uncorrectable codewords
+  int decode(const uint8_t *codes, int count, uint8_t *messages, int *status) const {
+    int failed = 0;
+    for (int n = 0; n < count; n++)
+    {
+      int ret = decodeOne(codes + n * kCodeLen, messages + n * kMessageLen);
+      if (ret < 0)
+        failed++;
+      if (status)
+        status[n] = ret;
+    }
+    return failed;
+  };
+
+  uint8_t mul(uint8_t a, uint8_t b) const { return mMul[(a << MM) | b]; };
+  uint8_t alphaTo(int i) const { return mAlphaTo[i]; };
+  uint8_t indexOf(uint8_t a) const { return mIndexOf[a]; };
+
+private:
+  void generateGaloisField() {
+    int mask = 1;
+    mAlphaTo[MM] = 0;
+    for (int i = 0; i < MM; i++)
+    {
+      mAlphaTo[i] = (uint8_t)mask;
+      if (POLY & (1 << i))
+        mAlphaTo[MM] ^= (uint8_t)mask;
+      mask <<= 1;
+    }
+    mask >>= 1;
+    for (int i = MM + 1; i < kNN; i++)
+    {
+      if (mAlphaTo[i - 1] >= mask)
+        mAlphaTo[i] = mAlphaTo[MM] ^ (uint8_t)((mAlphaTo[i - 1] ^ mask) << 1);
+      else
+        mAlphaTo[i] = (uint8_t)(mAlphaTo[i - 1] << 1);
+    }
+    mAlphaTo[kNN] = 0;
+
+    for (int i = 0; i < kNN; i++)
+      mIndexOf[mAlphaTo[i]] = (uint8_t)i;
+    mIndexOf[0] = kA0;
+
+    for (int a = 0; a <= kNN; a++)
+      for (int b = 0; b <= kNN; b++)
+        mMul[(a << MM) | b] = ((a == 0) || (b == 0)) ? 0 : mAlphaTo[(mIndexOf[a] + mIndexOf[b]) % kNN];
+  };
+
+  // gg(x) = (x - alpha^1)(x - alpha^2)...(x - alpha^2tt), polynomial form
+  void generatePoly() {
+    memset(mGg, 0, sizeof(mGg));
+    mGg[0] = 1;
+    for (int i = 1; i <= kNumParity; i++)
+    {
+      uint8_t root = mAlphaTo[i % kNN];
+      for (int j = i; j > 0; j--)
+        mGg[j] = mGg[j - 1] ^ mul(mGg[j], root);
+      mGg[0] = mul(mGg[0], root);
+    }
+  };
+
+  // systematic encoding, parity = x^2tt * m(x) mod gg(x)
+  void encodeOne(const uint8_t *message, uint8_t *code) const {
+    uint8_t bb[kNumParity];
+    memset(bb, 0, sizeof(bb));
+    for (int i = kMessageLen - 1; i >= 0; i--)
+    {
+      uint8_t feedback = message[i] ^ bb[kNumParity - 1];
+      for (int j = kNumParity - 1; j > 0; j--)
+        bb[j] = bb[j - 1] ^ mul(mGg[j], feedback);
+      bb[0] = mul(mGg[0], feedback);
+    }
+    memcpy(code, message, kMessageLen);
+    memcpy(code + kMessageLen, bb, kNumParity);
+  };
+
+  // Berlekamp-Massey, Chien search and Forney on the shortened codeword
+  int decodeOne(const uint8_t *code, uint8_t *message) const {
+    // polynomial coefficient i of the received word: parity first, then the message
+    uint8_t recd[kCodeLen];
+    memcpy(recd, code + kMessageLen, kNumParity);
+    memcpy(recd + kNumParity, code, kMessageLen);
+    memcpy(message, code, kMessageLen);
+
+    uint8_t s[kNumParity];
+    bool hasErrors = false;
+    for (int j = 0; j < kNumParity; j++)
+    {
+      uint8_t sum = 0;
+      for (int i = kCodeLen - 1; i >= 0; i--) // Horner at alpha^(j+1)
+        sum = mul(sum, mAlphaTo[j + 1]) ^ recd[i];
+      s[j] = sum;
+      hasErrors |= (sum != 0);
+    }
+    if (!hasErrors)
+      return 0;
+
+    // error locator lambda(x)
+    uint8_t lambda[kNumParity + 1], prev[kNumParity + 1], tmp[kNumParity + 1];
+    memset(lambda, 0, sizeof(lambda));
+    memset(prev, 0, sizeof(prev));
+    lambda[0] = 1;
+    prev[0] = 1;
+    int degree = 0;
+    int shift = 1;
+    uint8_t prevDiscrepancy = 1;
+    for (int k = 0; k < kNumParity; k++)
+    {
+      uint8_t discrepancy = s[k];
+      for (int i = 1; i <= degree; i++)
+        discrepancy ^= mul(lambda[i], s[k - i]);
+
+      if (discrepancy == 0)
+      {
+        shift++;
+        continue;
+      }
+
+      uint8_t scale = mAlphaTo[(mIndexOf[discrepancy] + kNN - mIndexOf[prevDiscrepancy]) % kNN];
+      memcpy(tmp, lambda, sizeof(lambda));
+      for (int i = shift; i <= kNumParity; i++)
+        lambda[i] ^= mul(scale, prev[i - shift]);
+
+      if (2 * degree <= k)
+      {
+        degree = k + 1 - degree;
+        memcpy(prev, tmp, sizeof(prev));
+        prevDiscrepancy = discrepancy;
+        shift = 1;
+      }
+      else
+        shift++;
+    }
+    if (degree > TT)
+      return -1;
+
+    // omega(x) = s(x) * lambda(x) mod x^2tt
+    uint8_t omega[kNumParity];
+    for (int i = 0; i < kNumParity; i++)
+    {
+      uint8_t sum = 0;
+      for (int j = 0; (j <= i) && (j <= degree); j++)
+        sum ^= mul(lambda[j], s[i - j]);
+      omega[i] = sum;
+    }
+
+    // roots of lambda at alpha^-i give error positions i, only the kCodeLen first are valid
+    int found = 0;
+    uint8_t corrected[kCodeLen];
+    memcpy(corrected, recd, kCodeLen);
+    for (int i = 0; i < kNN; i++)
+    {
+      int xinv = (kNN - i) % kNN;
+      uint8_t value = 0;
+      for (int j = degree; j >= 0; j--)
+        value = mul(value, mAlphaTo[xinv]) ^ lambda[j];
+      if (value != 0)
+        continue;
+      if (i >= kCodeLen)
+        return -1;
+
+      uint8_t num = 0;
+      for (int j = kNumParity - 1; j >= 0; j--)
+        num = mul(num, mAlphaTo[xinv]) ^ omega[j];
+      uint8_t den = 0; // formal derivative, odd terms only
+      for (int j = 1; j <= degree; j += 2)
+        den ^= mul(lambda[j], mAlphaTo[(xinv * (j - 1)) % kNN]);
+      if (den == 0)
+        return -1;
+
+      corrected[i] ^= mAlphaTo[(mIndexOf[num] + kNN - mIndexOf[den]) % kNN] & (num ? 0xFF : 0);
+      found++;
+    }
+    if (found != degree)
+      return -1;
+
+    memcpy(message, corrected + kNumParity, kMessageLen);
+    return found;
+  };
+
+  uint8_t mAlphaTo[kNN + 1];
+  uint8_t mIndexOf[kNN + 1];
+  uint8_t mGg[kNumParity + 1];
+  uint8_t mMul[(kNN + 1) << MM];
+};
+
+// Code used by BeepingCore: GF(2^5) with x^5 + x^2 + 1, 4 correctable errors and
+// 12 message symbols (front door, word and check tokens) giving 20 token codewords.
+typedef RSCodec<5, 4, 12, 0x25> BeepingRSCodec;
+
+#endif /* RSCodec_h */
@@ -0,0 +1,287 @@
+/*--------------------------------------------------------------------------------
+ Resampler.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "Resampler.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define RESAMPLER_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RESAMPLER_NEON
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846264338327950288
+#endif
+
+static long gcdLong(long a, long b)
+{
+  while (b != 0)
+  {
+    long t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// n is a multiple of 4
+static inline float dotProduct(const float *a, const float *b, int n)
+{
+#if defined(RESAMPLER_SSE)
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  int k = 0;
+  for (; k + 8 <= n; k += 8)
+  {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + k + 4), _mm_loadu_ps(b + k + 4)));
+  }
+  if (k < n)
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+  acc0 = _mm_add_ps(acc0, acc1);
+  acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+  acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+  return _mm_cvtss_f32(acc0);
+#elif defined(RESAMPLER_NEON)
+  float32x4_t acc = vdupq_n_f32(0.f);
+  for (int k = 0; k < n; k += 4)
+    acc = vmlaq_f32(acc, vld1q_f32(a + k), vld1q_f32(b + k));
+  float32x2_t sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+  return vget_lane_f32(vpadd_f32(sum, sum), 0);
+#else
+  float acc = 0.f;
+  for (int k = 0; k < n; k++)
+    acc += a[k] * b[k];
+  return acc;
+#endif
+}
+
+Resampler::Resampler()
+{
+  mInRate = 44100.f;
+  mOutRate = 44100.f;
+  mUp = 1;
+  mDown = 1;
+  mTapsPerPhase = 0;
+  mDelay = 0;
+  mHistPos = 0;
+  mPhase = 0;
+  mWait = 0;
+  mSkip = 0;
+  mInCount = 0;
+  mOutCount = 0;
+}
+
+float Resampler::getPassband(float inRate, float outRate)
+{
+  return 0.465f * std::min(inRate, outRate);
+}
+
+long Resampler::getNumTaps(int up, float inRate, float outRate)
+{
+  // Blackman windowed sinc at the upsampled rate, its transition band is ~5.5 / N of that rate
+  float passband = getPassband(inRate, outRate);
+  float stopband = 0.5f * std::min(inRate, outRate);
+  return (long)ceil(5.5 * inRate / (stopband - passband)) * up;
+}
+
+std::shared_ptr<const Resampler::FilterBank> Resampler::designFilterBank(int up, int down, float inRate, float outRate)
+{
+  std::shared_ptr<FilterBank> bank(new FilterBank());
+  bank->up = up;
+  bank->down = down;
+
+  float passband = getPassband(inRate, outRate);
+  float stopband = 0.5f * std::min(inRate, outRate);
+
+  // The length is 2 * delay * M + 1 so that the delay is a whole number of output samples.
+  int taps = (int)getNumTaps(up, inRate, outRate);
+  bank->delay = (taps - 1 + 2 * down - 1) / (2 * down);
+  int ntaps = 2 * bank->delay * down + 1;
+  bank->tapsPerPhase = (((ntaps + up - 1) / up) + 3) & ~3;
+
+  double cutoff = 0.5 * (passband + stopband) / ((double)inRate * up); // normalized to upsampled rate
+  std::vector<double> h(ntaps);
+  double center = 0.5 * (ntaps - 1);
+  double dcgain = 0.0;
+  for (int i = 0; i < ntaps; i++)
+  {
+    double x = i - center;
+    double sinc = (x == 0.0) ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+    double w = 0.42 - 0.5 * cos(2.0 * M_PI * i / (ntaps - 1)) + 0.08 * cos(4.0 * M_PI * i / (ntaps - 1));
+    h[i] = sinc * w;
+    dcgain += h[i];
+  }
+
+  // unity gain per phase (zero stuffing by L loses a factor L)
+  double scale = (double)up / dcgain;
+
+  // split into polyphase branches, time-reversed so each output is a forward dot product,
+  // branches are padded with zeros on the oldest side up to a multiple of 4 taps
+  const int T = bank->tapsPerPhase;
+  bank->phases.assign((size_t)T * up, 0.f);
+  for (int p = 0; p < up; p++)
+    for (int k = 0; k < T; k++)
+    {
+      int i = p + (T - 1 - k) * up;
+      if (i < ntaps)
+        bank->phases[p * T + k] = (float)(h[i] * scale);
+    }
+
+  return bank;
+}
+
+std::shared_ptr<const Resampler::FilterBank> Resampler::getFilterBank(int up, int down, float inRate, float outRate)
+{
+  static std::mutex cacheMutex;
+  static std::map<std::pair<long, long>, std::shared_ptr<const FilterBank> > cache;
+
+  std::pair<long, long> key((long)inRate, (long)outRate);
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  std::map<std::pair<long, long>, std::shared_ptr<const FilterBank> >::iterator it = cache.find(key);
+  if (it != cache.end())
+    return it->second;
+
+  std::shared_ptr<const FilterBank> bank = designFilterBank(up, down, inRate, outRate);
+  cache[key] = bank;
+  return bank;
+}
+
+int Resampler::configure(float inRate, float outRate)
+{
+  long in = (long)(inRate + 0.5f);
+  long out = (long)(outRate + 0.5f);
+  if ((in <= 0) || (out <= 0) || (fabsf(inRate - in) > 1e-3f) || (fabsf(outRate - out) > 1e-3f))
+    return -1;
+
+  if ((out > kMaxRatio * in) || (in > kMaxRatio * out))
+    return -1;
+
+  // rates with a large L give a filter bank of millions of taps, they are not converted
+  long g = gcdLong(in, out);
+  if ((out / g > kMaxUp) || (getNumTaps((int)(out / g), (float)in, (float)out) > kMaxTaps))
+    return -1;
+
+  mInRate = (float)in;
+  mOutRate = (float)out;
+  mUp = (int)(out / g);
+  mDown = (int)(in / g);
+
+  mBank = getFilterBank(mUp, mDown, mInRate, mOutRate);
+  mTapsPerPhase = mBank->tapsPerPhase;
+  mDelay = mBank->delay;
+
+  mHist.assign(2 * mTapsPerPhase, 0.f);
+
+  reset();
+
+  return 0;
+}
+
+void Resampler::reset()
+{
+  std::fill(mHist.begin(), mHist.end(), 0.f);
+  mHistPos = 0;
+  mPhase = 0;
+  mWait = 0;
+  mSkip = mDelay;
+  mInCount = 0;
+  mOutCount = 0;
+}
+
+int Resampler::process(const float *in, const int nsamples, float *out)
+{
+  int nout = 0;
+  const int T = mTapsPerPhase;
+  const float *phases = &mBank->phases[0];
+
+  for (int i = 0; i < nsamples; i++)
+  {
+    mHist[mHistPos] = in[i];
+    mHist[mHistPos + T] = in[i];
+    mHistPos++;
+    if (mHistPos == T)
+      mHistPos = 0;
+
+    while (mWait == 0)
+    {
+      // window of the last T samples, oldest first
+      float y = dotProduct(phases + mPhase * T, &mHist[mHistPos], T);
+      if (mSkip > 0)
+        mSkip--;
+      else
+        out[nout++] = y;
+
+      mPhase += mDown;
+      mWait = mPhase / mUp;
+      mPhase = mPhase % mUp;
+    }
+    mWait--;
+  }
+
+  mInCount += nsamples;
+  mOutCount += nout;
+  return nout;
+}
+
+int Resampler::flush(float *out, long totalOutput)
+{
+  if (totalOutput < 0)
+    totalOutput = getOutputLength(mInCount);
+
+  // push zeros through the filter until the delayed samples are out
+  const long inCount = mInCount;
+  const float zero = 0.f;
+  float step[64];
+  int nout = 0;
+  while (mOutCount < totalOutput)
+  {
+    long before = mOutCount;
+    int n = process(&zero, 1, step);
+    n = (int)std::min((long)n, totalOutput - before);
+    memcpy(out + nout, step, n * sizeof(float));
+    nout += n;
+    mOutCount = before + n;
+  }
+  mInCount = inCount;
+  return nout;
+}
+
+int Resampler::convert(const float *in, long nsamples, float inRate, float outRate, float *out, long nout)
+{
+  Resampler resampler;
+  if (resampler.configure(inRate, outRate) < 0)
+    return -1;
+
+  // in blocks so that the output never runs past nout
+  const int blockSize = 4096;
+  std::vector<float> block(resampler.getMaxOutputSamples(blockSize) + resampler.getMaxFlushSamples());
+  long written = 0;
+  for (long pos = 0; pos < nsamples; pos += blockSize)
+  {
+    int n = resampler.process(in + pos, (int)std::min((long)blockSize, nsamples - pos), &block[0]);
+    n = (int)std::min((long)n, nout - written);
+    memcpy(out + written, &block[0], n * sizeof(float));
+    written += n;
+  }
+  while (written < nout)
+  {
+    int n = resampler.flush(&block[0], std::min(nout, written + (long)block.size()));
+    if (n <= 0)
+      break;
+    memcpy(out + written, &block[0], n * sizeof(float));
+    written += n;
+  }
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*--------------------------------------------------------------------------------
+ Resampler.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef Resampler_h
+#define Resampler_h
+
+#include <memory>
+#include <vector>
+
+// Polyphase sample rate converter by L/M for integer rates, up or down.
+//
+// Same structure as the Decimator without the frequency shift: a Blackman windowed sinc
+// designed at inRate * L keeps everything below 0.465 * min(inRate, outRate) (20.5 kHz
+// for 44.1 kHz, above the non-audible band) and is split into L branches. The filter banks
+// are cached by rate pair and shared by every channel and every instance.
+//
+// The filter delay is compensated: output sample k is the input signal at k / outRate
+// seconds. A stream of n input samples gives getOutputLength(n) samples once flush() has
+// been called.
+class Resampler{
+public:
+  enum
+  {
+    kMaxRatio = 32,       // largest inRate / outRate or outRate / inRate
+    kMaxUp = 1024,        // largest L, rates such as 44101 to 48000 would need L = 48000
+    kMaxTaps = 1 << 20    // largest prototype filter, 4 MB of coefficients
+  };
+
+  Resampler();
+  ~Resampler() {};
+
+  // returns 0 on success, -1 if a rate is not a positive integer, the ratio exceeds
+  // kMaxRatio or the conversion needs more than kMaxUp branches or kMaxTaps taps
+  int configure(float inRate, float outRate);
+  void reset();
+
+  // processes nsamples of input, writes at most getMaxOutputSamples(nsamples) samples to out
+  // returns the number of output samples written
+  int process(const float *in, const int nsamples, float *out);
+  // writes the last samples held by the filter, up to totalOutput samples since reset()
+  // (getOutputLength() of the input count if totalOutput < 0). returns the samples written
+  int flush(float *out, long totalOutput = -1);
+
+  int getMaxOutputSamples(const int nsamples) { return (int)(((long)nsamples * mUp) / mDown) + 2; };
+  int getMaxFlushSamples() { return mDelay + 2; };
+  long getOutputLength(long ninput) { return (ninput * mUp + mDown - 1) / mDown; };
+
+  // whole buffer conversion, out receives nout samples
+  static int convert(const float *in, long nsamples, float inRate, float outRate, float *out, long nout);
+
+  // highest frequency kept by a conversion between the two rates
+  static float getPassband(float inRate, float outRate);
+
+  long getInputCount() { return mInCount; };
+  long getOutputCount() { return mOutCount; };
+
+  float getInputSampleRate() { return mInRate; };
+  float getOutputSampleRate() { return mOutRate; };
+  int getUpFactor() { return mUp; };
+  int getDownFactor() { return mDown; };
+
+private:
+  struct FilterBank
+  {
+    int up;
+    int down;
+    int tapsPerPhase;            // multiple of 4 for the SIMD kernel
+    int delay;                   // in output samples
+    std::vector<float> phases;   // up phases of tapsPerPhase taps, each stored time-reversed
+  };
+
+  // length of the prototype filter before it is rounded to whole output samples
+  static long getNumTaps(int up, float inRate, float outRate);
+  static std::shared_ptr<const FilterBank> getFilterBank(int up, int down, float inRate, float outRate);
+  static std::shared_ptr<const FilterBank> designFilterBank(int up, int down, float inRate, float outRate);
+
+  float mInRate;
+  float mOutRate;
+  int mUp;             // L
+  int mDown;           // M
+  int mTapsPerPhase;
+  int mDelay;
+  std::shared_ptr<const FilterBank> mBank;
+
+  // history, stored twice so that every window is contiguous
+  std::vector<float> mHist;
+  int mHistPos;
+
+  int mPhase;          // current polyphase branch
+  int mWait;           // input samples to consume before next output
+  int mSkip;           // outputs still to drop for the delay compensation
+  long mInCount;
+  long mOutCount;
+};
+
+#endif /* Resampler_h */
@@ -0,0 +1,192 @@
+/*--------------------------------------------------------------------------------
+ Scanner.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "Scanner.h"
+
+#include "BeepingCoreLib_api.h"
+
+#include "MappedWav.h"
+#include "BufferPool.h"
+#include "Metrics.h"
+#include "StageTimers.h"
+#include "sndfile.h"
+
+#include <iostream>
+#include <string.h>
+#include <math.h>
+
+#ifndef MIN
+#define MIN(a,b) ((a <= b) ? (a) : (b))
+#endif
+
+// returns 1 if the decimator front-end is active, 0 if the decoder runs at the input rate
+int Scanner::configureDecimator(int mode, float sampleRate)
+{
+  if (mode == BEEPING_MODE_CUSTOM)
+    BEEPING_SetCustomBaseFreq(mCustomBaseFreq, mTonesSeparation, mBeepingCore);
+  BEEPING_Configure(mode, sampleRate, mBufferSize, mBeepingCore);
+
+  if (!mUseDecimator || (mode != BEEPING_MODE_CUSTOM))
+    return 0;
+
+  // Decoder bins are sampleRate/windowSize, which is the same 44100/2048 Hz grid at 44.1, 22.05
+  // and 11.025 kHz. The frequency shift is kept on that grid so tones stay on bin centers.
+  const float binWidth = 44100.f / 2048.f;
+  const float outRates[2] = { 11025.f, 22050.f };
+
+  float beginFreq = BEEPING_GetDecodingBeginFreq(mBeepingCore);
+  float endFreq = BEEPING_GetDecodingEndFreq(mBeepingCore);
+  float halfBandwidth = 0.5f * (endFreq - beginFreq) + 4.f * binWidth;
+  float centerFreq = floorf(0.5f * (beginFreq + endFreq) / binWidth + 0.5f) * binWidth;
+
+  for (int i = 0; i < 2; i++)
+  {
+    float outRate = outRates[i];
+    if (outRate >= sampleRate)
+      break;
+
+    float ifFreq = floorf(0.25f * outRate / binWidth + 0.5f) * binWidth;
+    if (mDecimator.configure(sampleRate, outRate, centerFreq, ifFreq, halfBandwidth) != 0)
+      continue;
+
+    float shift = mDecimator.getFrequencyShift();
+    BEEPING_SetCustomBaseFreq(mCustomBaseFreq - shift, mTonesSeparation, mBeepingCore);
+    BEEPING_Configure(mode, outRate, mBufferSize, mBeepingCore);
+
+    std::cout << "Decimator: band [" << beginFreq << ", " << endFreq << "] Hz shifted by -" << shift
+              << " Hz, decoding at " << outRate << " Hz (" << mDecimator.getUpFactor() << "/" << mDecimator.getDownFactor() << ")" << std::endl;
+    if (sampleRate != 44100.f)
+      std::cout << "Decimator: marks generated natively at " << sampleRate << " Hz use a different tone grid, scan them with decimation disabled" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Decimator: band [" << beginFreq << ", " << endFreq << "] Hz does not fit a lower decoding rate, decoding at " << sampleRate << " Hz" << std::endl;
+  return 0;
+}
+
+int Scanner::scan(const char *filename, int mode, std::vector<ScanDetection> &detections)
+{
+  // plain PCM files are read from a memory map, anything else through libsndfile
+  MappedWavReader mappedInput;
+  SNDFILE *pWaveFileInput = NULL;
+  int nch;
+  long nFrames;
+  float sampleRate;
+  if (mappedInput.open(filename) == MappedWav::kOk)
+  {
+    nch = mappedInput.getChannels();
+    nFrames = mappedInput.getFrames();
+    sampleRate = (float)mappedInput.getSampleRate();
+  }
+  else
+  {
+    SF_INFO sfinfoInput;
+    memset(&sfinfoInput, '\0', sizeof(sfinfoInput));
+    pWaveFileInput = sf_open(filename, SFM_READ, &sfinfoInput);
+    if (!pWaveFileInput)
+      return -1;
+
+    nch = sfinfoInput.channels;
+    nFrames = (long)sfinfoInput.frames;
+    sampleRate = (float)sfinfoInput.samplerate;
+  }
+
+  int useDecimator = configureDecimator(mode, sampleRate);
+  float decodingRate = useDecimator ? mDecimator.getOutputSampleRate() : sampleRate;
+
+  int buffersamples = 4096;
+  BufferPool bufferPool; // freed when the scan returns
+  float *pInputBufferInterleaved = bufferPool.allocate(buffersamples*nch);
+  float *pMonoBuffer = bufferPool.allocate(buffersamples);
+  float *pDecimatedBuffer = bufferPool.allocate(mDecimator.getMaxOutputSamples(buffersamples));
+  float *pDecodeBuffer = bufferPool.allocate(mBufferSize);
+  int decodeFill = 0;
+  long decodedSamples = 0;
+  char decodedString[64];
+
+  int progress_scan = 0;
+  std::cout << "Progress SCAN = " << progress_scan << std::endl;
+
+  long readFrames = 0;
+  int ReadCount;
+  Metrics::beginStage("scan", nFrames, sampleRate);
+  while (true)
+  {
+    {
+      ScopedTimer timer("read");
+      ReadCount = pWaveFileInput ? (int)sf_readf_float(pWaveFileInput, pInputBufferInterleaved, buffersamples) : mappedInput.read(pInputBufferInterleaved, buffersamples);
+    }
+    if (ReadCount <= 0)
+      break;
+
+    float current_progress_scan = ((float)readFrames / (float)nFrames)*100.f;
+    if (current_progress_scan > progress_scan + 5)
+    {
+      progress_scan = current_progress_scan;
+      std::cout << "Progress SCAN = " << progress_scan << std::endl;
+    }
+    readFrames += ReadCount;
+    Metrics::setFrames(readFrames);
+    ScopedTimer timer("decode");
+
+    // downmix to mono
+    for (int i = 0; i < ReadCount; i++)
+    {
+      float s = 0.f;
+      for (int t = 0; t < nch; t++)
+        s += pInputBufferInterleaved[i*nch + t];
+      pMonoBuffer[i] = s / nch;
+    }
+
+    const float *pSamples = pMonoBuffer;
+    int nSamples = ReadCount;
+    if (useDecimator)
+    {
+      nSamples = mDecimator.process(pMonoBuffer, ReadCount, pDecimatedBuffer);
+      pSamples = pDecimatedBuffer;
+    }
+
+    // feed the decoder in blocks of the configured buffer size
+    int pos = 0;
+    while (pos < nSamples)
+    {
+      int n = MIN(mBufferSize - decodeFill, nSamples - pos);
+      memcpy(pDecodeBuffer + decodeFill, pSamples + pos, n * sizeof(float));
+      decodeFill += n;
+      pos += n;
+
+      if (decodeFill == mBufferSize)
+      {
+        int ret = BEEPING_DecodeAudioBuffer(pDecodeBuffer, mBufferSize, mBeepingCore);
+        decodedSamples += mBufferSize;
+        decodeFill = 0;
+
+        if (ret == -3) // complete word decoded
+        {
+          memset(decodedString, 0, sizeof(decodedString));
+          int size = BEEPING_GetDecodedData(decodedString, mBeepingCore);
+          if (size != 0)
+          {
+            ScanDetection detection;
+            detection.time = (double)decodedSamples / decodingRate;
+            detection.data = std::string(decodedString, MIN(abs(size), (int)sizeof(decodedString)));
+            detection.hasPayload = Payload::fromString(detection.data.c_str(), (int)detection.data.size(), detection.payload);
+            detection.status = size;
+            detection.confidence = BEEPING_GetConfidence(mBeepingCore);
+            detections.push_back(detection);
+          }
+        }
+      }
+    }
+  }
+
+  std::cout << "Progress SCAN = " << 100 << std::endl;
+
+  if (pWaveFileInput)
+    sf_close(pWaveFileInput);
+
+  return 0;
+}
@@ -0,0 +1,60 @@
+/*--------------------------------------------------------------------------------
+ Scanner.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef Scanner_h
+#define Scanner_h
+
+#include <vector>
+#include <string>
+
+#include "Decimator.h"
+#include "Payload.h"
+
+struct ScanDetection
+{
+  double time;        // seconds from the beginning of the file when the mark was completed
+  std::string data;   // decoded characters
+  Payload payload;    // decoded characters as a payload, if hasPayload
+  bool hasPayload;
+  int status;         // >0 ok, <0 decoded with errors (see BEEPING_GetDecodedData)
+  float confidence;
+};
+
+// Decodes all the audio marks found in an input file using the BeepingCore decoder.
+// In custom mode the input can optionally go through a Decimator front-end that moves
+// the decoding band down to a lower sample rate before it reaches the decoder.
+class Scanner{
+public:
+  Scanner(void *beepingCore){
+    mBeepingCore = beepingCore;
+    mBufferSize = 128;
+    mCustomBaseFreq = 12000.f;
+    mTonesSeparation = 1;
+    mUseDecimator = false;
+  };
+
+  ~Scanner() {};
+
+  int scan(const char *filename, int mode, std::vector<ScanDetection> &detections);
+
+  // set functions
+  void setBufferSize(int val) { mBufferSize = val; };
+  void setCustomBaseFreq(float baseFreq, int tonesSeparation) { mCustomBaseFreq = baseFreq; mTonesSeparation = tonesSeparation; };
+  void setUseDecimator(bool val) { mUseDecimator = val; };
+
+private:
+  int configureDecimator(int mode, float sampleRate);
+
+  void *mBeepingCore;
+  int mBufferSize;
+  float mCustomBaseFreq;
+  int mTonesSeparation;
+  bool mUseDecimator;
+
+  Decimator mDecimator;
+};
+
+#endif /* Scanner_h */
@@ -0,0 +1,64 @@
+/*--------------------------------------------------------------------------------
+ SpscRing.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef SpscRing_h
+#define SpscRing_h
+
+#include <atomic>
+#include <vector>
+
+// Lock-free ring buffer for one producer thread and one consumer thread.
+//
+// The producer only writes mTail and the consumer only writes mHead, each index is
+// published with release and read with acquire ordering, so an element is fully written
+// before the other side sees it. Indices run freely and are masked, the capacity is
+// rounded up to a power of two. push() and pop() never block, callers decide how to wait.
+template <typename T>
+class SpscRing{
+public:
+  SpscRing(int capacity) {
+    int size = 1;
+    while (size < capacity)
+      size <<= 1;
+    mItems.resize(size);
+    mMask = size - 1;
+    mHead.store(0, std::memory_order_relaxed);
+    mTail.store(0, std::memory_order_relaxed);
+  };
+
+  ~SpscRing() {};
+
+  // producer side, returns false if the ring is full
+  bool push(const T &item) {
+    const unsigned tail = mTail.load(std::memory_order_relaxed);
+    if (tail - mHead.load(std::memory_order_acquire) > mMask)
+      return false;
+    mItems[tail & mMask] = item;
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+  };
+
+  // consumer side, returns false if the ring is empty
+  bool pop(T &item) {
+    const unsigned head = mHead.load(std::memory_order_relaxed);
+    if (head == mTail.load(std::memory_order_acquire))
+      return false;
+    item = mItems[head & mMask];
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+  };
+
+  int getCapacity() const { return (int)mMask + 1; };
+
+private:
+  std::vector<T> mItems;
+  unsigned mMask;
+  // head and tail on their own cache lines, they are written by different threads
+  alignas(64) std::atomic<unsigned> mHead;
+  alignas(64) std::atomic<unsigned> mTail;
+};
+
+#endif /* SpscRing_h */
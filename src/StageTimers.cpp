@@ -0,0 +1,159 @@
+/*--------------------------------------------------------------------------------
+ StageTimers.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "StageTimers.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+
+std::atomic<bool> StageTimers::sEnabled(false);
+bool StageTimers::sTrace = false;
+int64_t StageTimers::sStart = 0;
+std::mutex StageTimers::sMutex;
+std::vector<StageTimers::ThreadLog*> StageTimers::sLogs;
+
+void StageTimers::enable(bool trace)
+{
+  sTrace = trace;
+  sStart = Metrics::now();
+  getThreadLog(); // the enabling thread is thread 0
+  sEnabled.store(true, std::memory_order_relaxed);
+}
+
+StageTimers::ThreadLog *StageTimers::getThreadLog()
+{
+  // logs live until the process exits, the summary may outlive the threads
+  static thread_local ThreadLog *log = NULL;
+  if (!log)
+  {
+    log = new ThreadLog();
+    log->dropped = 0;
+    std::lock_guard<std::mutex> lock(sMutex);
+    log->tid = (int)sLogs.size();
+    sLogs.push_back(log);
+  }
+  return log;
+}
+
+void StageTimers::record(const char *name, int64_t start, int64_t end)
+{
+  ThreadLog *log = getThreadLog();
+  const int64_t duration = end - start;
+
+  // a literal may have one address per translation unit, compare the text when they differ
+  Stat *stat = NULL;
+  for (int i = 0; i < (int)log->stats.size() && !stat; i++)
+    if ((log->stats[i].name == name) || (strcmp(log->stats[i].name, name) == 0))
+      stat = &log->stats[i];
+  if (!stat)
+  {
+    Stat s = { name, 0, 0, 0 };
+    log->stats.push_back(s);
+    stat = &log->stats.back();
+  }
+  stat->count++;
+  stat->total += duration;
+  if (duration > stat->max)
+    stat->max = duration;
+
+  if (sTrace)
+  {
+    if ((int)log->events.size() < kMaxEvents)
+    {
+      Event e = { name, start, duration };
+      log->events.push_back(e);
+    }
+    else
+      log->dropped++;
+  }
+}
+
+void StageTimers::reset()
+{
+  std::lock_guard<std::mutex> lock(sMutex);
+  for (int t = 0; t < (int)sLogs.size(); t++)
+  {
+    sLogs[t]->stats.clear();
+    sLogs[t]->events.clear();
+    sLogs[t]->dropped = 0;
+  }
+  sStart = Metrics::now();
+}
+
+double StageTimers::getTotalSeconds(const char *name)
+{
+  std::lock_guard<std::mutex> lock(sMutex);
+  int64_t total = 0;
+  for (int t = 0; t < (int)sLogs.size(); t++)
+  {
+    const ThreadLog *log = sLogs[t];
+    for (int i = 0; i < (int)log->stats.size(); i++)
+      if ((log->stats[i].name == name) || (strcmp(log->stats[i].name, name) == 0))
+        total += log->stats[i].total;
+  }
+  return total * 1e-9;
+}
+
+void StageTimers::printSummary()
+{
+  std::lock_guard<std::mutex> lock(sMutex);
+  const double elapsed = (Metrics::now() - sStart) * 1e-6;
+
+  // through std::cout, which goes to stderr when stdout carries the audio
+  char line[160];
+  snprintf(line, sizeof(line), "STAGE TIMES (wall clock, %.1f ms since the timers started):", elapsed);
+  std::cout << line << std::endl;
+  snprintf(line, sizeof(line), " %-12s %6s %9s %12s %10s %10s %7s", "stage", "thread", "calls", "total ms", "mean ms", "max ms", "%");
+  std::cout << line << std::endl;
+  for (int t = 0; t < (int)sLogs.size(); t++)
+  {
+    const ThreadLog *log = sLogs[t];
+    for (int i = 0; i < (int)log->stats.size(); i++)
+    {
+      const Stat &s = log->stats[i];
+      double total = s.total * 1e-6;
+      snprintf(line, sizeof(line), " %-12s %6d %9ld %12.2f %10.4f %10.4f %7.1f", s.name, log->tid, s.count, total,
+               total / s.count, s.max * 1e-6, (elapsed > 0.0) ? 100.0 * total / elapsed : 0.0);
+      std::cout << line << std::endl;
+    }
+  }
+}
+
+int StageTimers::writeTrace(const char *filename)
+{
+  FILE *file = fopen(filename, "w");
+  if (!file)
+    return -1;
+
+  std::lock_guard<std::mutex> lock(sMutex);
+  // complete events, times in microseconds since the timers started
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  long dropped = 0;
+  for (int t = 0; t < (int)sLogs.size(); t++)
+  {
+    const ThreadLog *log = sLogs[t];
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+            first ? "" : ",\n", log->tid, (log->tid == 0) ? "main" : "worker", log->tid);
+    first = false;
+    for (int i = 0; i < (int)log->events.size(); i++)
+    {
+      const Event &e = log->events[i];
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+              e.name, log->tid, (e.start - sStart) * 1e-3, e.duration * 1e-3);
+    }
+    dropped += log->dropped;
+  }
+  fprintf(file, "\n]}\n");
+
+  bool error = (ferror(file) != 0);
+  if (fclose(file) != 0)
+    error = true;
+  if (dropped > 0)
+    fprintf(stderr, "Trace is missing %ld events over the limit of %d per thread\n", dropped, (int)kMaxEvents);
+  return error ? -1 : 0;
+}
@@ -0,0 +1,87 @@
+/*--------------------------------------------------------------------------------
+ StageTimers.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef StageTimers_h
+#define StageTimers_h
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "Metrics.h"
+
+// Wall time spent in each stage, per thread.
+//
+// A ScopedTimer measures its scope on the monotonic clock and adds it to the log of the
+// calling thread, so threads never share a log while they run. Every stage keeps a
+// count, total and maximum; with tracing on, each scope is also kept as an event for a
+// Chrome trace (chrome://tracing, Perfetto). When the timers are not enabled a
+// ScopedTimer only reads one flag.
+//
+// reset(), getTotalSeconds(), printSummary() and writeTrace() read every log: call them
+// once the threads that used timers have been joined.
+class StageTimers{
+public:
+  static void enable(bool trace);
+  static bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); };
+
+  // name must be a string literal, start and end from Metrics::now()
+  static void record(const char *name, int64_t start, int64_t end);
+
+  // forgets every stat and event, the logs of the threads are kept
+  static void reset();
+  // time spent in a stage by every thread, in seconds (0 if it never ran)
+  static double getTotalSeconds(const char *name);
+
+  // table of the stages by thread, in order of first use
+  static void printSummary();
+  // returns 0 on success, -1 if the file cannot be written
+  static int writeTrace(const char *filename);
+
+private:
+  struct Stat
+  {
+    const char *name;
+    long count;
+    int64_t total;
+    int64_t max;
+  };
+  struct Event
+  {
+    const char *name;
+    int64_t start;
+    int64_t duration;
+  };
+  struct ThreadLog
+  {
+    int tid;
+    std::vector<Stat> stats;
+    std::vector<Event> events;
+    long dropped;                 // events over kMaxEvents
+  };
+  enum { kMaxEvents = 1 << 20 };  // per thread, 24 MB
+
+  static ThreadLog *getThreadLog();
+
+  static std::atomic<bool> sEnabled;
+  static bool sTrace;
+  static int64_t sStart;
+  static std::mutex sMutex;       // guards sLogs
+  static std::vector<ThreadLog*> sLogs;
+};
+
+class ScopedTimer{
+public:
+  ScopedTimer(const char *name) : mName(name), mStart(StageTimers::isEnabled() ? Metrics::now() : 0) {};
+  ~ScopedTimer() { if (mStart != 0) StageTimers::record(mName, mStart, Metrics::now()); };
+
+private:
+  const char *mName;
+  int64_t mStart;
+};
+
+#endif /* StageTimers_h */
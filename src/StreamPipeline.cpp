@@ -0,0 +1,271 @@
+/*--------------------------------------------------------------------------------
+ StreamPipeline.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "StreamPipeline.h"
+
+#include "PlanarIO.h"
+#include "Metrics.h"
+#include "StageTimers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+StreamPipeline::StreamPipeline(int channels, float inputRate, float markingRate, float outputRate, int blockFrames, int numBlocks)
+  : mFree(numBlocks), mRead(numBlocks), mMixed(numBlocks)
+{
+  mChannels = channels;
+  mBlockFrames = blockFrames;
+  mMarkingRate = markingRate;
+  mReadFrames = blockFrames;
+  mInputFrames = 0;
+  mWriteError.store(false);
+  mTimeline = NULL;
+
+  mInputRate = inputRate;
+  mOutputRate = outputRate;
+  mConvertInput = (inputRate != markingRate);
+  mConvertOutput = (outputRate != markingRate);
+  if (mConvertInput)
+  {
+    mInputResamplers.resize(channels);
+    for (int t = 0; t < channels; t++)
+      mInputResamplers[t].configure(inputRate, markingRate);
+    // converted blocks must fit in blockFrames
+    Resampler &r = mInputResamplers[0];
+    mReadFrames = (int)(((long)(blockFrames - 2) * r.getDownFactor()) / r.getUpFactor());
+    if (mReadFrames < 1)
+      mReadFrames = 1;
+  }
+  if (mConvertOutput)
+  {
+    mOutputResamplers.resize(channels);
+    for (int t = 0; t < channels; t++)
+      mOutputResamplers[t].configure(markingRate, outputRate);
+  }
+
+  mBlocks.resize(numBlocks);
+  for (int i = 0; i < numBlocks; i++)
+  {
+    Block &block = mBlocks[i];
+    block.samples.assign((size_t)channels * blockFrames, 0.f);
+    block.channel.resize(channels);
+    for (int t = 0; t < channels; t++)
+      block.channel[t] = &block.samples[(size_t)t * blockFrames];
+    block.frames = 0;
+    block.end = false;
+  }
+}
+
+StreamPipeline::~StreamPipeline()
+{
+}
+
+void StreamPipeline::backoff(int spin)
+{
+  // a stage waiting on a slow pipe should not keep a core busy
+  if (spin < 64)
+    return;
+  if (spin < 1024)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+void StreamPipeline::push(SpscRing<Block*> &ring, Block *block)
+{
+  for (int spin = 0; !ring.push(block); spin++)
+    backoff(spin);
+}
+
+StreamPipeline::Block *StreamPipeline::pop(SpscRing<Block*> &ring)
+{
+  Block *block = NULL;
+  for (int spin = 0; !ring.pop(block); spin++)
+    backoff(spin);
+  return block;
+}
+
+int StreamPipeline::run(PcmStreamReader &reader, PcmStreamWriter &writer, BeepTrack &beepTrack, Mixer &mixer)
+{
+  mWriteError.store(false);
+  mInputFrames = 0;
+  for (int t = 0; t < (int)mInputResamplers.size(); t++)
+    mInputResamplers[t].reset();
+  for (int t = 0; t < (int)mOutputResamplers.size(); t++)
+    mOutputResamplers[t].reset();
+  for (int i = 0; i < (int)mBlocks.size(); i++)
+    mFree.push(&mBlocks[i]);
+
+  std::thread readThread(&StreamPipeline::readLoop, this, &reader);
+  std::thread writeThread(&StreamPipeline::writeLoop, this, &writer);
+
+  std::vector<float> beeps(mBlockFrames);
+  mixer.beginBlocks(mChannels, mMarkingRate);
+  while (true)
+  {
+    Block *block = pop(mRead);
+    const bool end = block->end; // the block belongs to the writer once pushed
+    int frames = 0;
+    if (block->frames > 0)
+    {
+      {
+        ScopedTimer timer("encode");
+        beepTrack.render(&beeps[0], block->frames, 1.f);
+      }
+      ScopedTimer timer("mix");
+      frames = mixer.mixBlock((const float**)&block->channel[0], block->frames, mChannels, &beeps[0], &block->channel[0]);
+    }
+    if (end) // frames held back by the limiter
+      frames += mixer.flushBlocks(&block->channel[0], frames, mBlockFrames - frames);
+    block->frames = frames;
+    push(mMixed, block);
+    if (end)
+      break;
+  }
+
+  readThread.join();
+  writeThread.join();
+
+  // every block is back in the free ring, empty it for the next run
+  Block *block;
+  while (mFree.pop(block))
+    ;
+
+  return mWriteError.load() ? -1 : 0;
+}
+
+int StreamPipeline::convertInput(const float *interleaved, int n, std::vector<float*> &scratch, Block *block)
+{
+  if (!mConvertInput)
+  {
+    PlanarIO::deinterleave(interleaved, n, mChannels, &block->channel[0], 0);
+    return n;
+  }
+
+  PlanarIO::deinterleave(interleaved, n, mChannels, &scratch[0], 0);
+  int frames = 0;
+  for (int t = 0; t < mChannels; t++)
+    frames = mInputResamplers[t].process(scratch[t], n, block->channel[t]);
+  return frames;
+}
+
+void StreamPipeline::readLoop(PcmStreamReader *reader)
+{
+  std::vector<float> interleaved((size_t)mReadFrames * mChannels);
+  std::vector<float> scratchSamples(mConvertInput ? (size_t)mReadFrames * mChannels : 0);
+  std::vector<float*> scratch(mChannels);
+  for (int t = 0; t < mChannels && mConvertInput; t++)
+    scratch[t] = &scratchSamples[(size_t)t * mReadFrames];
+
+  bool done = false;
+  while (!done)
+  {
+    Block *block = pop(mFree);
+    int frames = 0;
+    while (frames == 0) // a few input frames may not give any converted frame yet
+    {
+      // stop reading once the output is gone
+      int n;
+      {
+        ScopedTimer timer("read");
+        n = mWriteError.load() ? 0 : reader->read(&interleaved[0], mReadFrames);
+      }
+      if (n <= 0)
+      {
+        // end of the input, the converter still holds the last frames
+        if (mConvertInput)
+        {
+          long target = mInputResamplers[0].getOutputLength(mInputResamplers[0].getInputCount());
+          target = std::min(target, mInputResamplers[0].getOutputCount() + mBlockFrames);
+          for (int t = 0; t < mChannels; t++)
+            frames = mInputResamplers[t].flush(block->channel[t], target);
+        }
+        done = (frames == 0);
+        break;
+      }
+      mInputFrames += n;
+      ScopedTimer timer("deinterleave");
+      frames = convertInput(&interleaved[0], n, scratch, block);
+    }
+    block->frames = frames;
+    block->end = done;
+    push(mRead, block);
+  }
+}
+
+void StreamPipeline::writeOutput(PcmStreamWriter *writer, float *const *channel, int n, std::vector<float> &interleaved)
+{
+  if (mWriteError.load() || (n <= 0))
+    return;
+  {
+    ScopedTimer timer("interleave");
+    PlanarIO::interleave((const float* const*)channel, 0, n, mChannels, &interleaved[0]);
+  }
+  {
+    ScopedTimer timer("write");
+    if (writer->write(&interleaved[0], n) < n)
+      mWriteError.store(true);
+  }
+  Metrics::addFrames(n);
+  if (mTimeline)
+  {
+    ScopedTimer timer("loudness");
+    mTimeline->add(&interleaved[0], n);
+  }
+}
+
+void StreamPipeline::writeLoop(PcmStreamWriter *writer)
+{
+  int maxFrames = mBlockFrames;
+  if (mConvertOutput)
+    maxFrames = std::max(mOutputResamplers[0].getMaxOutputSamples(mBlockFrames), mBlockFrames);
+
+  std::vector<float> interleaved((size_t)maxFrames * mChannels);
+  std::vector<float> scratchSamples(mConvertOutput ? (size_t)maxFrames * mChannels : 0);
+  std::vector<float*> scratch(mChannels);
+  for (int t = 0; t < mChannels && mConvertOutput; t++)
+    scratch[t] = &scratchSamples[(size_t)t * maxFrames];
+
+  while (true)
+  {
+    Block *block = pop(mMixed);
+    const int frames = block->frames;
+    const bool end = block->end;
+    if (frames > 0)
+    {
+      if (!mConvertOutput)
+        writeOutput(writer, &block->channel[0], frames, interleaved);
+      else
+      {
+        int n = 0;
+        for (int t = 0; t < mChannels; t++)
+          n = mOutputResamplers[t].process(block->channel[t], frames, scratch[t]);
+        writeOutput(writer, &scratch[0], n, interleaved);
+      }
+    }
+    push(mFree, block);
+    if (end)
+      break;
+  }
+
+  // the output lasts as long as the input
+  if (mConvertOutput)
+  {
+    Resampler &r = mOutputResamplers[0];
+    const long outputFrames = (long)((double)mInputFrames * mOutputRate / mInputRate + 0.5);
+    while (r.getOutputCount() < outputFrames)
+    {
+      long target = std::min(outputFrames, r.getOutputCount() + maxFrames);
+      int n = 0;
+      for (int t = 0; t < mChannels; t++)
+        n = mOutputResamplers[t].flush(scratch[t], target);
+      if (n <= 0)
+        break;
+      writeOutput(writer, &scratch[0], n, interleaved);
+    }
+  }
+}
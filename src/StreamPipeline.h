@@ -0,0 +1,86 @@
+/*--------------------------------------------------------------------------------
+ StreamPipeline.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef StreamPipeline_h
+#define StreamPipeline_h
+
+#include <atomic>
+#include <vector>
+
+#include "SpscRing.h"
+#include "PcmStream.h"
+#include "BeepTrack.h"
+#include "Mixer.h"
+#include "Resampler.h"
+#include "LoudnessTimeline.h"
+
+// Streaming mix in three stages running at the same time:
+//   reader thread: reads and deinterleaves input frames into a planar block
+//                  (converted to the marking rate when the input rate differs)
+//   caller thread: renders the beeps of the block and mixes them in place
+//   writer thread: converts the mixed block to the output rate when it differs from the
+//                  marking rate, then interleaves and writes it
+//
+// Blocks of blockFrames frames are allocated once. They go from stage to stage through
+// SPSC rings, and a free ring takes written blocks back to the reader, so nothing is
+// allocated while streaming and at most numBlocks blocks are in flight. The last block of
+// the input is flagged and goes through every stage, a block may carry no frames (the
+// converters and the limiter hold back a few frames at the start).
+class StreamPipeline{
+public:
+  // rates must be supported by Resampler when they differ
+  StreamPipeline(int channels, float inputRate, float markingRate, float outputRate, int blockFrames = 4096, int numBlocks = 4);
+  ~StreamPipeline();
+
+  // returns 0 when the whole input has been mixed and written, -1 on write error
+  int run(PcmStreamReader &reader, PcmStreamWriter &writer, BeepTrack &beepTrack, Mixer &mixer);
+  // the written frames are also measured by the timeline, on the writer thread
+  void setTimeline(LoudnessTimeline *timeline) { mTimeline = timeline; };
+
+private:
+  struct Block
+  {
+    std::vector<float> samples;     // channel t starts at t * blockFrames
+    std::vector<float*> channel;
+    int frames;
+    bool end;                       // last block of the input
+  };
+
+  void readLoop(PcmStreamReader *reader);
+  void writeLoop(PcmStreamWriter *writer);
+  // converts or copies n input frames into the block, returns the block frames
+  int convertInput(const float *interleaved, int n, std::vector<float*> &scratch, Block *block);
+  // interleaves and writes n frames that are already at the output rate
+  void writeOutput(PcmStreamWriter *writer, float *const *channel, int n, std::vector<float> &interleaved);
+
+  // spin, then yield, then sleep while the ring is full / empty
+  static void backoff(int spin);
+  static void push(SpscRing<Block*> &ring, Block *block);
+  static Block *pop(SpscRing<Block*> &ring);
+
+  int mChannels;
+  int mBlockFrames;
+  float mMarkingRate;
+  int mReadFrames;             // input frames read per block
+  std::vector<Block> mBlocks;
+
+  float mInputRate;
+  float mOutputRate;
+  bool mConvertInput;
+  bool mConvertOutput;
+  std::vector<Resampler> mInputResamplers;    // one per channel, reader thread
+  std::vector<Resampler> mOutputResamplers;   // one per channel, writer thread
+  long mInputFrames;           // written by the reader before the end block, read by the writer after it
+
+  SpscRing<Block*> mFree;      // writer -> reader
+  SpscRing<Block*> mRead;      // reader -> mixer
+  SpscRing<Block*> mMixed;     // mixer -> writer
+
+  std::atomic<bool> mWriteError;
+  LoudnessTimeline *mTimeline;
+};
+
+#endif /* StreamPipeline_h */
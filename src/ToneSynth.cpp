@@ -0,0 +1,148 @@
+/*--------------------------------------------------------------------------------
+ ToneSynth.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "ToneSynth.h"
+
+#include "Globals.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef MIN
+#define MIN(a,b) ((a <= b) ? (a) : (b))
+#endif
+
+ToneSynth::ToneSynth()
+{
+  mSamplingRate = 0.f;
+  mTokenSamples = 0;
+  mFadeInSamples = 0;
+  mTable = ToneTable();
+  reset();
+}
+
+int ToneSynth::configure(int mode, float samplingRate, float customBaseFreq, int tonesSeparation)
+{
+  if ((mode != BEEPING_MODE_AUDIBLE) && (mode != BEEPING_MODE_NONAUDIBLE) && (mode != BEEPING_MODE_HIDDEN) && (mode != BEEPING_MODE_CUSTOM))
+    return -1;
+
+  const ToneTable *table = ToneTables::find(mode, samplingRate);
+  if (table && (mode != BEEPING_MODE_CUSTOM))
+    mTable = *table;
+  else
+    mTable = ToneTables::makeToneTable(mode, samplingRate, ToneTables::windowSizeFor(samplingRate), customBaseFreq, tonesSeparation);
+
+  // token and fade lengths are truncated from float products as BeepingCore does,
+  // durFade is a fraction of the token
+  const float tokenSamples = Globals::durToken * samplingRate;
+  mSamplingRate = samplingRate;
+  mTokenSamples = (int)tokenSamples;
+  mFadeInSamples = (int)(Globals::durFade * tokenSamples);
+
+  // amplitudes are stepped in double precision from tokenAmplitude - 0.05 like the core
+  const float amplitude = (float)((double)Globals::tokenAmplitude - 0.05);
+  makeEnvelope((float)((double)amplitude + 0.05), (int)(tokenSamples * 0.05f), 0, mEnvelope[0]);
+  makeEnvelope((float)((double)amplitude + 0.025), (int)(tokenSamples * 0.1f), (int)(tokenSamples * 0.05f), mEnvelope[1]);
+  makeEnvelope(amplitude, (int)(tokenSamples * 0.1f), (int)(tokenSamples * 0.05f), mEnvelope[2]);
+
+  reset();
+  return 0;
+}
+
+void ToneSynth::makeEnvelope(float amplitude, int fadeOutSamples, int silenceSamples, std::vector<float> &envelope)
+{
+  const int T = mTokenSamples;
+  const int fadeOutEnd = T - silenceSamples;
+  envelope.assign(T, 0.f);
+  for (int n = 0; n < fadeOutEnd; n++)
+  {
+    if (n < mFadeInSamples)
+      envelope[n] = (float)n * amplitude / (float)mFadeInSamples;
+    else if (n > fadeOutEnd - fadeOutSamples)
+      envelope[n] = amplitude * (float)(fadeOutEnd - n) / (float)fadeOutSamples;
+    else
+      envelope[n] = amplitude;
+  }
+}
+
+void ToneSynth::reset()
+{
+  for (int k = 0; k < kNumTones; k++)
+  {
+    mPhaseRe[k] = 1.0;
+    mPhaseIm[k] = 0.0;
+  }
+}
+
+int ToneSynth::render(const Payload &payload, float *out, float gain)
+{
+  uint8_t tokens[MarkCode::kNumTokens];
+  mMarkCode.encode(&payload, 1, tokens);
+  return render(tokens, out, gain);
+}
+
+int ToneSynth::render(const uint8_t *tokens, float *out, float gain)
+{
+  reset();
+  for (int i = 0; i < MarkCode::kNumTokens; i++)
+    renderToken(i, tokens[i] & 31, out + i * mTokenSamples, gain);
+  return getMarkSamples();
+}
+
+void ToneSynth::renderToken(int position, int token, float *out, float gain)
+{
+  const int T = mTokenSamples;
+  const bool frontDoor = (position < MarkCode::kNumFrontDoor);
+  const float *env = &mEnvelope[MIN(position, kNumEnvelopes - 1)][0];
+
+  memset(out, 0, T * sizeof(float));
+
+  const float hop = frontDoor ? 0.f : mTable.hop[(position - 1) % ToneTables::kNumHops];
+
+  for (int k = 0; k < kNumTones; k++)
+  {
+    const double w = 2.0 * M_PI * (mTable.tokenFreq[token][k] + hop) / mSamplingRate;
+
+    // the second tone of a front door token is not heard but its phase runs
+    if (!frontDoor || (k == 0))
+    {
+      const float toneGain = frontDoor ? gain * mTable.tokenLoudness[token][0] : gain * 0.5f * mTable.tokenLoudness[token][k];
+
+      // lanes hold the phasor at n, n+1, n+2, n+3 and are rotated by 4 samples per step,
+      // the phase is advanced before each sample is taken
+      float re[kNumLanes], im[kNumLanes];
+      for (int l = 0; l < kNumLanes; l++)
+      {
+        re[l] = (float)(mPhaseRe[k] * cos((l + 1) * w) - mPhaseIm[k] * sin((l + 1) * w));
+        im[l] = (float)(mPhaseRe[k] * sin((l + 1) * w) + mPhaseIm[k] * cos((l + 1) * w));
+      }
+      const float stepRe = (float)cos(kNumLanes * w);
+      const float stepIm = (float)sin(kNumLanes * w);
+
+      int n = 0;
+      for (; n + kNumLanes <= T; n += kNumLanes)
+      {
+        for (int l = 0; l < kNumLanes; l++)
+        {
+          out[n + l] += toneGain * env[n + l] * im[l];
+
+          float r = re[l] * stepRe - im[l] * stepIm;
+          im[l] = re[l] * stepIm + im[l] * stepRe;
+          re[l] = r;
+        }
+      }
+      for (int l = 0; n + l < T; l++)
+        out[n + l] += toneGain * env[n + l] * im[l];
+    }
+
+    // keep the phase running through the whole token, silence included
+    double r = mPhaseRe[k] * cos(T * w) - mPhaseIm[k] * sin(T * w);
+    double i = mPhaseRe[k] * sin(T * w) + mPhaseIm[k] * cos(T * w);
+    double norm = 1.0 / sqrt(r * r + i * i);
+    mPhaseRe[k] = r * norm;
+    mPhaseIm[k] = i * norm;
+  }
+}
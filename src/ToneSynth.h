@@ -0,0 +1,74 @@
+/*--------------------------------------------------------------------------------
+ ToneSynth.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef ToneSynth_h
+#define ToneSynth_h
+
+#include <stdint.h>
+#include <vector>
+
+#include "MarkEncoder.h"
+#include "ToneTables.h"
+#include "MarkCode.h"
+#include "Payload.h"
+
+// Native encoder for the multi-tone modes (only tones, synth type 0), following the
+// token layout of the BeepingCore multi-tone encoders: durToken long tokens with a linear
+// fade-in over durFade of the token, a linear fade-out over 10% of the token and a
+// silence of 5% (the first token fades out over its last 5% with no silence), two tones
+// per token (one for the front door tokens) with the loudness of the tone table. Token
+// amplitude is tokenAmplitude for the first token, tokenAmplitude - 0.025 for the second
+// and tokenAmplitude - 0.05 for the others.
+//
+// Tones come from a bank of recursive oscillators (complex rotators) advanced four samples
+// at a time, so the inner loop has no sin() calls and vectorizes. As in BeepingCore every
+// mark starts at phase 0 and both oscillators run through all its tokens, the silent
+// second tone of the front door tokens included.
+//
+// test/ToneSynthTest.cpp checks the rendered marks against BEEPING_EncodeDataToAudioBuffer.
+class ToneSynth : public MarkEncoder{
+public:
+  enum
+  {
+    kNumTones = 2,     // oscillators per token
+    kNumLanes = 4,     // samples computed per oscillator step
+    kNumEnvelopes = 3  // first token, second token, other tokens
+  };
+
+  ToneSynth();
+  ~ToneSynth() {};
+
+  // customBaseFreq and tonesSeparation are only used in custom mode
+  // returns 0 on success, -1 if the mode is not a multi-tone mode
+  int configure(int mode, float samplingRate, float customBaseFreq, int tonesSeparation);
+  void reset();
+
+  // renders one mark (getMarkSamples() samples) scaled by gain, the buffer is overwritten
+  int render(const Payload &payload, float *out, float gain);
+  int render(const uint8_t *tokens, float *out, float gain);
+
+  int getMarkSamples() { return MarkCode::kNumTokens * mTokenSamples; };
+  int getMaxMarkSamples() { return getMarkSamples(); };
+  int getTokenSamples() { return mTokenSamples; };
+
+private:
+  void renderToken(int position, int token, float *out, float gain);
+  void makeEnvelope(float amplitude, int fadeOutSamples, int silenceSamples, std::vector<float> &envelope);
+
+  ToneTable mTable;
+  float mSamplingRate;
+  int mTokenSamples;
+  int mFadeInSamples;
+  std::vector<float> mEnvelope[kNumEnvelopes]; // token amplitude included
+
+  // oscillator state, unit phasors
+  double mPhaseRe[kNumTones];
+  double mPhaseIm[kNumTones];
+
+  MarkCode mMarkCode;
+};
+
+#endif /* ToneSynth_h */
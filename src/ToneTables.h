@@ -0,0 +1,170 @@
+/*--------------------------------------------------------------------------------
+ ToneTables.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef ToneTables_h
+#define ToneTables_h
+
+#include "BeepingCoreLib_api.h"
+
+// Tone layout of the multi-tone modes, same values as the Globals::getFreqsFromIdx*MultiTone,
+// getLoudness*MultiToneFromIdx and getIdxsFromIdx*MultiTone functions of BeepingCore.
+//
+// Every token is a pair of the 9 tones of the mode. Tone frequencies are placed on the
+// analysis grid (samplingRate / windowSize) and all tones of a token except the front door
+// ones are shifted by a hop of 0, 1 or 2 times freqOffset depending on the token position.
+//
+// Tables of the fixed modes are built at compile time for 44.1 and 48 kHz with their
+// window size, so the hot paths index flat arrays:
+//   const ToneTable &t = ToneTableFor<BEEPING_MODE_NONAUDIBLE, 44100, 2048>::value;
+//   float f = t.tokenFreq[token][0] + t.hop[position % 3];
+// Custom mode depends on the base frequency given at run time, use makeToneTable() for it.
+namespace ToneTables
+{
+  enum
+  {
+    kNumTokens = 32,
+    kNumTones = 9,
+    kNumHops = 3
+  };
+}
+
+struct ToneTable
+{
+  float bandwidth;                                  // analysis bin width in Hz
+  float freqOffset;                                 // hop size in Hz
+  float toneFreq[ToneTables::kNumTones];
+  float toneLoudness[ToneTables::kNumTones];
+  unsigned char tokenTone[ToneTables::kNumTokens][2];
+  float tokenFreq[ToneTables::kNumTokens][2];
+  float tokenLoudness[ToneTables::kNumTokens][2];
+  float hop[ToneTables::kNumHops];                  // shift of token i (i >= 2) is hop[(i - 1) % 3]
+};
+
+namespace ToneTables
+{
+  // window size used by BeepingCore for a sampling rate
+  constexpr int windowSizeFor(float samplingRate)
+  {
+    return ((samplingRate == 44100.f) || (samplingRate == 48000.f)) ? 2048 :
+           (samplingRate == 22050.f) ? 1024 :
+           (samplingRate == 11025.f) ? 512 : 256;
+  }
+
+  constexpr int roundToInt(double x) { return (int)(x + 0.5); }
+
+  // e^x for |x| < 1, enough for the audible loudness curve
+  constexpr double expSeries(double x)
+  {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int n = 1; n < 24; n++)
+    {
+      term *= x / n;
+      sum += term;
+    }
+    return sum;
+  }
+
+  constexpr int nBinsOffsetFor(int mode, int tonesSeparation)
+  {
+    return (mode == BEEPING_MODE_AUDIBLE) ? 12 :
+           (mode == BEEPING_MODE_HIDDEN) ? 3 :
+           (mode == BEEPING_MODE_CUSTOM) ? tonesSeparation + 2 : 4;
+  }
+
+  // customBaseFreq and tonesSeparation are only used in custom mode
+  constexpr ToneTable makeToneTable(int mode, float samplingRate, int windowSize, float customBaseFreq = 12000.f, int tonesSeparation = 1)
+  {
+    ToneTable t = {};
+    const double bw = (double)samplingRate / windowSize;
+    const double freqOffset = nBinsOffsetFor(mode, tonesSeparation) * 44100.0 / windowSize;
+    t.bandwidth = (float)bw;
+    t.freqOffset = (float)freqOffset;
+
+    double base = 0.0;
+    double step = 0.0;
+    if (mode == BEEPING_MODE_AUDIBLE)
+    {
+      base = roundToInt(3300.0 / bw) * bw;
+      step = roundToInt(750.0 / bw) * bw;
+    }
+    else
+    {
+      double baseFreq = (mode == BEEPING_MODE_HIDDEN) ? 14000.0 : (mode == BEEPING_MODE_CUSTOM) ? (double)customBaseFreq : 17800.0;
+      base = roundToInt(baseFreq / bw) * bw;
+      step = roundToInt(3.0 * freqOffset / bw) * bw;
+    }
+
+    for (int i = 0; i < kNumTones; i++)
+    {
+      t.toneFreq[i] = (float)(base + i * step);
+      if (mode == BEEPING_MODE_AUDIBLE) // 10^((1 - i/9) * -6/20)
+        t.toneLoudness[i] = (float)expSeries((1.0 - i / 9.0) * (-6.0 / 20.0) * 2.302585092994046);
+      else
+        t.toneLoudness[i] = (float)(0.85 + i * 0.15 / 8.0);
+    }
+
+    // tokens are the tone pairs in lexicographic order (0,1), (0,2) ... (0,8), (1,2) ...
+    int token = 0;
+    for (int a = 0; (a < kNumTones) && (token < kNumTokens); a++)
+    {
+      for (int b = a + 1; (b < kNumTones) && (token < kNumTokens); b++)
+      {
+        t.tokenTone[token][0] = (unsigned char)a;
+        t.tokenTone[token][1] = (unsigned char)b;
+        t.tokenFreq[token][0] = t.toneFreq[a];
+        t.tokenFreq[token][1] = t.toneFreq[b];
+        t.tokenLoudness[token][0] = t.toneLoudness[a];
+        t.tokenLoudness[token][1] = t.toneLoudness[b];
+        token++;
+      }
+    }
+
+    for (int h = 0; h < kNumHops; h++)
+      t.hop[h] = (float)(h * freqOffset);
+
+    return t;
+  }
+}
+
+template <int MODE, int SAMPLERATE, int WINDOWSIZE = ToneTables::windowSizeFor((float)SAMPLERATE)>
+struct ToneTableFor
+{
+  static constexpr ToneTable value = ToneTables::makeToneTable(MODE, (float)SAMPLERATE, WINDOWSIZE);
+};
+
+template <int MODE, int SAMPLERATE, int WINDOWSIZE>
+constexpr ToneTable ToneTableFor<MODE, SAMPLERATE, WINDOWSIZE>::value;
+
+namespace ToneTables
+{
+  // compile-time table of a fixed mode (audible, non-audible, hidden) at 44.1 or 48 kHz
+  // with the BeepingCore window size, or 0 if there is none
+  inline const ToneTable *find(int mode, float samplingRate)
+  {
+    if (samplingRate == 44100.f)
+    {
+      switch (mode)
+      {
+      case BEEPING_MODE_AUDIBLE: return &ToneTableFor<BEEPING_MODE_AUDIBLE, 44100>::value;
+      case BEEPING_MODE_NONAUDIBLE: return &ToneTableFor<BEEPING_MODE_NONAUDIBLE, 44100>::value;
+      case BEEPING_MODE_HIDDEN: return &ToneTableFor<BEEPING_MODE_HIDDEN, 44100>::value;
+      }
+    }
+    else if (samplingRate == 48000.f)
+    {
+      switch (mode)
+      {
+      case BEEPING_MODE_AUDIBLE: return &ToneTableFor<BEEPING_MODE_AUDIBLE, 48000>::value;
+      case BEEPING_MODE_NONAUDIBLE: return &ToneTableFor<BEEPING_MODE_NONAUDIBLE, 48000>::value;
+      case BEEPING_MODE_HIDDEN: return &ToneTableFor<BEEPING_MODE_HIDDEN, 48000>::value;
+      }
+    }
+    return 0;
+  }
+}
+
+#endif /* ToneTables_h */
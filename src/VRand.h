@@ -14,6 +14,7 @@
 #define __VRand_H_
 
 #include <time.h>
+#include <stdint.h>
 
 // Usage:
 // ------
@@ -37,6 +38,7 @@ public:
     m_count = 1;
     m_brown = 0.0f;
     m_pink  = 0;
+    m_seed  = 0;
     for (int i=0; i<NumPinkBins; i++)
     {
       m_pinkStore[i] = 0.0f;
@@ -45,8 +47,8 @@ public:
 
   void seed(unsigned long seed=0)
   {
-    if (seed == 0) m_seed = time(NULL);
-    else           m_seed = seed;
+    if (seed == 0) m_seed = (uint32_t)time(NULL);
+    else           m_seed = (uint32_t)seed;
   };
 
   // returns psuedo random white noise number
@@ -54,13 +56,13 @@ public:
   //
   inline float white(float scale=0.5f)
   {
+     // 32 bit state, 23 random mantissa bits of a float in [2, 4)
      m_seed   = (m_seed * 196314165) + 907633515;
      m_white  = m_seed >> 9; 
      m_white |= 0x40000000; 
-     return ((*(float*)&m_white)-3.0f)*scale; 
+     return (toFloat(m_white)-3.0f)*scale; 
   };
 
-
 #ifdef WIN32
   int inline CTZ(int num)
   {
@@ -72,12 +74,10 @@ public:
     }
     return num;
   }
-#else // please contribute assembler for mac/sparc/sgi/etc.
-  int inline CTZ(int num)
+#else
+  int inline CTZ(uint32_t num)
   {
-    int i=0;
-    while (((num>>i)&1)==0 && i<sizeof(int)) i++;
-    return i;
+    return (num == 0) ? 32 : __builtin_ctz(num);
   }
 #endif
 
@@ -131,9 +131,16 @@ public:
   }
 
 private:
-  unsigned long  m_seed;
-  unsigned long  m_count;
-  unsigned long  m_white;
+  static inline float toFloat(uint32_t bits)
+  {
+    union { uint32_t i; float f; } u;
+    u.i = bits;
+    return u.f;
+  }
+
+  uint32_t       m_seed;
+  uint32_t       m_count;
+  uint32_t       m_white;
   float          m_pink;
   float          m_brown;
   float          m_pinkStore[NumPinkBins];
@@ -141,6 +148,122 @@ private:
 
 
 
+// Counter-based noise: every number is a hash of (seed, stream, sample index), with no
+// state carried from one sample to the next. Any sample can be rendered first, chunks
+// rendered on different threads stitch exactly, and a chunk is bit-reproducible
+// from its seed, stream and start index.
+//
+// Pink noise is the Voss-McCartney sum of NumPinkBins octave bins plus a white term,
+// bin k holding a value that changes every 2^(k+1) samples, so its value at any index
+// is known. Brown noise weights the same bins by 2^(k/2) (-6 dB/octave down to
+// fs / 2^(NumPinkBins+1)) instead of integrating white noise, which could not jump.
+// Bins are summed in integers so the result never depends on where a chunk starts.
+//
+// Usage:
+// ------
+// VRandCounter rand(seed, channel);
+// rand.pinkBlock(startIndex, buffer, n, scale); // samples startIndex.. in -scale to scale
+class VRandCounter
+{
+public:
+  enum
+  {
+    NumPinkBins = 16
+  };
+
+  VRandCounter(uint64_t seed=1, uint32_t stream=0)
+  {
+    setSeed(seed, stream);
+  };
+
+  void setSeed(uint64_t seed, uint32_t stream=0)
+  {
+    m_key = mix(seed ^ mix(0x9E3779B97F4A7C15ULL * ((uint64_t)stream + 1)));
+    for (int k=0; k<=NumPinkBins; k++)
+      m_binKey[k] = mix(m_key + 0xD1B54A32D192ED03ULL * (uint64_t)(k + 1));
+  };
+
+  // white noise number of sample index in the range -scale to scale
+  inline float white(uint64_t index, float scale=0.5f) const
+  {
+    return value(m_key, index) * (scale / 8388608.f);
+  };
+
+  void whiteBlock(uint64_t index, float *out, int n, float scale=0.5f) const
+  {
+    const float gain = scale / 8388608.f;
+    for (int i=0; i<n; i++)
+      out[i] = value(m_key, index + i) * gain;
+  };
+
+  void pinkBlock(uint64_t index, float *out, int n, float scale=0.5f) const
+  {
+    static const int64_t weights[NumPinkBins + 1] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+    binBlock(weights, NumPinkBins + 1, index, out, n, scale);
+  };
+
+  void brownBlock(uint64_t index, float *out, int n, float scale=0.5f) const
+  {
+    // round(16 * 2^(k/2)), no white term
+    static const int64_t weights[NumPinkBins + 1] = { 16, 23, 32, 45, 64, 91, 128, 181, 256, 362, 512, 724, 1024, 1448, 2048, 2896, 0 };
+    binBlock(weights, 9850, index, out, n, scale);
+  };
+
+private:
+  // SplitMix64 finalizer
+  static inline uint64_t mix(uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+  };
+
+  // 24 bit signed number for counter c of a key
+  static inline int32_t value(uint64_t key, uint64_t c)
+  {
+    return (int32_t)(mix(key + 0x9E3779B97F4A7C15ULL * c) >> 40) - 8388608;
+  };
+
+  // bin k of sample i holds value number (i + 2^k) >> (k+1), the last key is the white term
+  void binBlock(const int64_t *weights, int64_t weightSum, uint64_t index, float *out, int n, float scale) const
+  {
+    int64_t bins[NumPinkBins];
+    int64_t sum = 0;
+    for (int k=0; k<NumPinkBins; k++)
+    {
+      bins[k] = weights[k] * value(m_binKey[k], (index + (1ULL << k)) >> (k + 1));
+      sum += bins[k];
+    }
+
+    const float gain = scale / (8388608.f * (float)weightSum);
+    const int64_t whiteWeight = weights[NumPinkBins];
+    for (int i=0; i<n; i++)
+    {
+      uint64_t c = index + i;
+      // only bin ctz(c) changes at sample c
+      int k = (c == 0) ? NumPinkBins : __builtin_ctzll(c);
+      if ((i > 0) && (k < NumPinkBins))
+      {
+        sum -= bins[k];
+        bins[k] = weights[k] * value(m_binKey[k], (c + (1ULL << k)) >> (k + 1));
+        sum += bins[k];
+      }
+      int64_t v = sum;
+      if (whiteWeight != 0)
+        v += whiteWeight * value(m_binKey[NumPinkBins], c);
+      out[i] = (float)v * gain;
+    }
+  };
+
+  uint64_t m_key;
+  uint64_t m_binKey[NumPinkBins + 1];
+};
+
+
+
 
 // This is a little helper section for fast table
 // lookup pink noise to use in denormalising
@@ -166,7 +289,7 @@ public:
   VPinkNoiseGlobal(void)
   {
     VRand rand;
-    rand.seed();
+    rand.seed(1); // same table on every run
     double inaudible = 0.000000059604644775390625; //pow(2.0, -24.0);
     for (int i=0; i<PinkNoiseBins; i++)
     {
@@ -0,0 +1,161 @@
+/*--------------------------------------------------------------------------------
+ WatchList.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include "WatchList.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+
+static inline uint32_t hashKey(uint32_t key)
+{
+  return key * 2654435761u; // Knuth multiplicative hash, use the top bits
+}
+
+WatchList::WatchList()
+{
+  mSlots.assign(64, (uint32_t)kEmptySlot);
+  mSlotKey.assign(64, -1);
+  mMask = 63;
+  mShift = 32 - 6;
+}
+
+int WatchList::find(uint32_t key)
+{
+  uint32_t slot = hashKey(key) >> mShift;
+  while (true)
+  {
+    if (mSlots[slot] == key)
+      return slot;
+    if (mSlots[slot] == (uint32_t)kEmptySlot)
+      return -1;
+    slot = (slot + 1) & mMask;
+  }
+}
+
+void WatchList::grow()
+{
+  int capacity = (mMask + 1) * 2;
+  mSlots.assign(capacity, (uint32_t)kEmptySlot);
+  mSlotKey.assign(capacity, -1);
+  mMask = capacity - 1;
+  mShift--;
+
+  for (int k = 0; k < (int)mOrder.size(); k++)
+  {
+    uint32_t slot = hashKey(mOrder[k]) >> mShift;
+    while (mSlots[slot] != (uint32_t)kEmptySlot)
+      slot = (slot + 1) & mMask;
+    mSlots[slot] = mOrder[k];
+    mSlotKey[slot] = k;
+  }
+}
+
+int WatchList::addKey(const char *key)
+{
+  if (strlen(key) != Payload::kKeyChars)
+    return -1;
+  int32_t packed = Payload::packKey(key);
+  if (packed < 0)
+    return -1;
+  if (find((uint32_t)packed) >= 0)
+    return 1;
+
+  if (2 * (mOrder.size() + 1) > mSlots.size())
+    grow();
+
+  mOrder.push_back((uint32_t)packed);
+  mHits.push_back(0);
+  mFirstTime.push_back(0.0);
+  mLastTime.push_back(0.0);
+
+  uint32_t slot = hashKey((uint32_t)packed) >> mShift;
+  while (mSlots[slot] != (uint32_t)kEmptySlot)
+    slot = (slot + 1) & mMask;
+  mSlots[slot] = (uint32_t)packed;
+  mSlotKey[slot] = (int32_t)mOrder.size() - 1;
+
+  return 0;
+}
+
+int WatchList::load(const char *filename)
+{
+  std::ifstream file(filename);
+  if (!file.is_open())
+    return -1;
+
+  int loaded = 0;
+  std::string line;
+  while (std::getline(file, line))
+  {
+    // trim whitespace and carriage returns
+    size_t b = line.find_first_not_of(" \t\r");
+    if ((b == std::string::npos) || (line[b] == '#'))
+      continue;
+    size_t e = line.find_last_not_of(" \t\r");
+    std::string key = line.substr(b, e - b + 1);
+
+    int ret = addKey(key.c_str());
+    if (ret == 0)
+      loaded++;
+    else if (ret < 0)
+      fprintf(stderr, "Wrong key in watch list [%s], skipped\n", key.c_str());
+  }
+
+  return loaded;
+}
+
+int WatchList::match(const Payload &payload, double time)
+{
+  int slot = find(payload.getKey());
+  if (slot < 0)
+    return -1;
+
+  int k = mSlotKey[slot];
+  if (mHits[k] == 0)
+    mFirstTime[k] = time;
+  mLastTime[k] = time;
+  mHits[k]++;
+
+  return k;
+}
+
+int WatchList::getNumKeysHit()
+{
+  int n = 0;
+  for (int k = 0; k < (int)mHits.size(); k++)
+    if (mHits[k] > 0)
+      n++;
+  return n;
+}
+
+int WatchList::writeReport(const char *filename)
+{
+  FILE *file = stdout;
+  if (filename && (strlen(filename) > 0))
+    file = fopen(filename, "w");
+  if (!file)
+    return -1;
+
+  fprintf(file, "key,hits,first,last\n");
+  for (int k = 0; k < (int)mOrder.size(); k++)
+  {
+    if (mHits[k] == 0)
+      continue;
+
+    char key[Payload::kKeyChars + 1];
+    for (int i = 0; i < Payload::kKeyChars; i++)
+      key[i] = Payload::valToChar(mOrder[k] >> (Payload::kBitsPerChar * (Payload::kKeyChars - 1 - i)));
+    key[Payload::kKeyChars] = '\0';
+
+    fprintf(file, "%s,%u,%.3f,%.3f\n", key, mHits[k], mFirstTime[k], mLastTime[k]);
+  }
+
+  if (file != stdout)
+    fclose(file);
+  return 0;
+}
@@ -0,0 +1,60 @@
+/*--------------------------------------------------------------------------------
+ WatchList.h
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#ifndef WatchList_h
+#define WatchList_h
+
+#include <vector>
+#include <stdint.h>
+
+#include "Payload.h"
+
+// Set of 5 character keys (base 32, digits in {0-9, a-v}) matched against decoded payloads.
+//
+// Keys are packed into 25 bit integers (see Payload) and stored in an open addressing hash table with
+// linear probing kept at most half full, so a lookup touches one or two adjacent slots.
+// Hit statistics are kept per key in load order.
+class WatchList{
+public:
+  WatchList();
+  ~WatchList() {};
+
+  // loads one key per line, empty lines and lines starting with '#' are skipped
+  // returns the number of keys loaded or <0 if the file cannot be read
+  int load(const char *filename);
+
+  // returns 0 if added, 1 if it was already in the list, -1 if the key is not valid
+  int addKey(const char *key);
+
+  // looks up the key of a decoded payload and updates its statistics
+  // returns the key index (load order) or -1 if it is not in the list
+  int match(const Payload &payload, double time);
+
+  // writes "key,hits,first,last" for every key with hits, in load order (to stdout if filename is empty)
+  int writeReport(const char *filename);
+
+  int getNumKeys() { return (int)mOrder.size(); };
+  int getNumKeysHit();
+
+private:
+  int find(uint32_t key);
+  void grow();
+
+  enum { kEmptySlot = 0xFFFFFFFF };
+
+  std::vector<uint32_t> mSlots;   // packed keys
+  std::vector<int32_t> mSlotKey;  // slot -> key index
+  int mMask;
+  int mShift;
+
+  // per key statistics, in load order
+  std::vector<uint32_t> mOrder;   // key index -> packed key
+  std::vector<uint32_t> mHits;
+  std::vector<double> mFirstTime;
+  std::vector<double> mLastTime;
+};
+
+#endif /* WatchList_h */
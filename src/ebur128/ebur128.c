@@ -11,6 +11,18 @@
 /* This can be replaced by any BSD-like queue implementation. */
 #include <sys/queue.h>
 
+#ifdef _WIN32
+#include <windows.h>
+static SRWLOCK cache_lock = SRWLOCK_INIT;
+#define CACHE_LOCK   AcquireSRWLockExclusive(&cache_lock);
+#define CACHE_UNLOCK ReleaseSRWLockExclusive(&cache_lock);
+#else
+#include <pthread.h>
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define CACHE_LOCK   pthread_mutex_lock(&cache_lock);
+#define CACHE_UNLOCK pthread_mutex_unlock(&cache_lock);
+#endif
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846264338327950288
 #endif
@@ -34,20 +46,37 @@ struct ebur128_dq_entry {
 
 #define ALMOST_ZERO 0.000001
 
+typedef struct {              // Subfilter of the polyphase FIR interpolator
+  unsigned int count;         // Number of coefficients in this subfilter
+  unsigned int* index;        // Delay index of corresponding filter coeff
+  double* coeff;              // List of subfilter coefficients
+} interp_filter;
+
+typedef struct interp_coeffs { // Cached subfilters, shared by every interpolator
+  unsigned int factor;        // with the same taps and factor, never modified
+  unsigned int taps;
+  unsigned int delay;
+  interp_filter* filter;
+  struct interp_coeffs* next;
+} interp_coeffs;
+
 typedef struct {              // Data structure for polyphase FIR interpolator
   unsigned int factor;        // Interpolation factor of the interpolator
   unsigned int taps;          // Taps (prefer odd to increase zero coeffs)
   unsigned int channels;      // Number of channels
   unsigned int delay;         // Size of delay buffer
-  struct {
-    unsigned int count;       // Number of coefficients in this subfilter
-    unsigned int* index;      // Delay index of corresponding filter coeff
-    double* coeff;            // List of subfilter coefficients
-  }* filter;                  // List of subfilters (one for each factor)
+  const interp_filter* filter;// List of subfilters (one for each factor), shared
   float** z;                  // List of delay buffers (one for each channel)
   unsigned int zi;            // Current delay buffer index
 } interpolator;
 
+typedef struct filter_coeffs { // Cached BS.1770 filter of one samplerate
+  unsigned long samplerate;
+  double b[5];
+  double a[5];
+  struct filter_coeffs* next;
+} filter_coeffs;
+
 struct ebur128_state_internal {
   /** Filtered audio data (used as ring buffer). */
   double* audio_data;
@@ -63,7 +92,7 @@ struct ebur128_state_internal {
   int* channel_map;
   /** How many samples fit in 100ms (rounded). */
   unsigned long samples_in_100ms;
-  /** BS.1770 filter coefficients (nominator). */
+  /** BS.1770 filter coefficients (nominator), copied from the cache. */
   double b[5];
   /** BS.1770 filter coefficients (denominator). */
   double a[5];
@@ -79,6 +108,9 @@ struct ebur128_state_internal {
   unsigned long st_block_list_size;
   int use_histogram;
   unsigned long *block_energy_histogram;
+  /** Running sum and count of the histogram blocks, for the relative gate. */
+  double block_energy_sum;
+  unsigned long block_energy_count;
   unsigned long *short_term_block_energy_histogram;
   /** Keeps track of when a new short term block is needed. */
   size_t short_term_frame_counter;
@@ -100,64 +132,145 @@ struct ebur128_state_internal {
 
 static double relative_gate = -10.0;
 
-/* Those will be calculated when initializing the library */
+/* Those are calculated once, by the first ebur128_init() */
+static int tables_ready = 0;
 static double relative_gate_factor;
 static double minus_twenty_decibels;
 static double histogram_energies[1000];
 static double histogram_energy_boundaries[1001];
 
-static interpolator* interp_create(unsigned int taps, unsigned int factor, unsigned int channels) {
-  interpolator* interp = calloc(1, sizeof(interpolator));
+/* Coefficient caches, filled on demand under cache_lock. The entries are
+ * immutable once linked and live until the process exits, so states hold
+ * plain pointers to them. */
+static interp_coeffs* interp_cache = NULL;
+static filter_coeffs* filter_cache = NULL;
+
+static void init_tables(void) {
+  int i;
+  relative_gate_factor = pow(10.0, relative_gate / 10.0);
+  minus_twenty_decibels = pow(10.0, -20.0 / 10.0);
+  histogram_energy_boundaries[0] = pow(10.0, (-70.0 + 0.691) / 10.0);
+  for (i = 0; i < 1000; ++i) {
+    histogram_energies[i] = pow(10.0, ((double) i / 10.0 - 69.95 + 0.691) / 10.0);
+  }
+  for (i = 1; i < 1001; ++i) {
+    histogram_energy_boundaries[i] = pow(10.0, ((double) i / 10.0 - 70.0 + 0.691) / 10.0);
+  }
+}
+
+static void ebur128_init_tables(void) {
+  CACHE_LOCK
+  if (!tables_ready) {
+    init_tables();
+    tables_ready = 1;
+  }
+  CACHE_UNLOCK
+}
+
+static interp_coeffs* interp_coeffs_create(unsigned int taps, unsigned int factor) {
+  interp_coeffs* coeffs = calloc(1, sizeof(interp_coeffs));
   unsigned int j = 0;
+  if (!coeffs) return NULL;
 
-  interp->taps = taps;
-  interp->factor = factor;
-  interp->channels = channels;
-  interp->delay = (interp->taps + interp->factor - 1) / interp->factor;
+  coeffs->taps = taps;
+  coeffs->factor = factor;
+  coeffs->delay = (taps + factor - 1) / factor;
 
   // Initialize the filter memory
   // One subfilter per interpolation factor.
-  interp->filter = calloc(interp->factor, sizeof(*interp->filter));
-  for (j = 0; j < interp->factor; j++) {
-    interp->filter[j].index = calloc(interp->delay, sizeof(unsigned int));
-    interp->filter[j].coeff = calloc(interp->delay, sizeof(double));
-  }
-  // One delay buffer per channel.
-  interp->z = calloc(interp->channels, sizeof(float*));
-  for (j = 0; j < interp->channels; j++) {
-    interp->z[j] = calloc( interp->delay, sizeof(float) );
+  coeffs->filter = calloc(factor, sizeof(interp_filter));
+  if (!coeffs->filter) goto free_coeffs;
+  for (j = 0; j < factor; j++) {
+    coeffs->filter[j].index = calloc(coeffs->delay, sizeof(unsigned int));
+    coeffs->filter[j].coeff = calloc(coeffs->delay, sizeof(double));
+    if (!coeffs->filter[j].index || !coeffs->filter[j].coeff) goto free_filter;
   }
 
   // Calculate the filter coefficients
-  for (j = 0; j < interp->taps; j++) {
+  for (j = 0; j < taps; j++) {
     // Calculate sinc
-    double m = (double)j - (double)(interp->taps - 1) / 2.0;
+    double m = (double)j - (double)(taps - 1) / 2.0;
     double c = 1.0;
     if (fabs(m) > ALMOST_ZERO) {
-      c = sin(m * M_PI / interp->factor) / (m * M_PI / interp->factor);
+      c = sin(m * M_PI / factor) / (m * M_PI / factor);
     }
     // Apply Hanning window
-    c *= 0.5 * (1 - cos(2 * M_PI * j / (interp->taps - 1)));
+    c *= 0.5 * (1 - cos(2 * M_PI * j / (taps - 1)));
 
     if (fabs(c) > ALMOST_ZERO) { // Ignore any zero coeffs.
       // Put the coefficient into the correct subfilter
-      unsigned int f = j % interp->factor;
-      unsigned int t = interp->filter[f].count++;
-      interp->filter[f].coeff[t] = c;
-      interp->filter[f].index[t] = j / interp->factor;
+      unsigned int f = j % factor;
+      unsigned int t = coeffs->filter[f].count++;
+      coeffs->filter[f].coeff[t] = c;
+      coeffs->filter[f].index[t] = j / factor;
     }
   }
+  return coeffs;
+
+free_filter:
+  for (j = 0; j < factor; j++) {
+    free(coeffs->filter[j].index);
+    free(coeffs->filter[j].coeff);
+  }
+  free(coeffs->filter);
+free_coeffs:
+  free(coeffs);
+  return NULL;
+}
+
+static const interp_coeffs* interp_get_coeffs(unsigned int taps, unsigned int factor) {
+  interp_coeffs* coeffs;
+  CACHE_LOCK
+  for (coeffs = interp_cache; coeffs; coeffs = coeffs->next) {
+    if (coeffs->taps == taps && coeffs->factor == factor) break;
+  }
+  if (!coeffs) {
+    coeffs = interp_coeffs_create(taps, factor);
+    if (coeffs) {
+      coeffs->next = interp_cache;
+      interp_cache = coeffs;
+    }
+  }
+  CACHE_UNLOCK
+  return coeffs;
+}
+
+static interpolator* interp_create(unsigned int taps, unsigned int factor, unsigned int channels) {
+  const interp_coeffs* coeffs = interp_get_coeffs(taps, factor);
+  interpolator* interp;
+  unsigned int j = 0;
+  if (!coeffs) return NULL;
+  interp = calloc(1, sizeof(interpolator));
+  if (!interp) return NULL;
+
+  interp->taps = taps;
+  interp->factor = factor;
+  interp->channels = channels;
+  interp->delay = coeffs->delay;
+  interp->filter = coeffs->filter;
+
+  // One delay buffer per channel.
+  interp->z = calloc(interp->channels, sizeof(float*));
+  if (!interp->z) goto free_interp;
+  for (j = 0; j < interp->channels; j++) {
+    interp->z[j] = calloc( interp->delay, sizeof(float) );
+    if (!interp->z[j]) goto free_z;
+  }
   return interp;
+
+free_z:
+  for (j = 0; j < interp->channels; j++) {
+    free(interp->z[j]);
+  }
+  free(interp->z);
+free_interp:
+  free(interp);
+  return NULL;
 }
 
 static void interp_destroy(interpolator* interp) {
   unsigned int j = 0;
   if (!interp) return;
-  for (j = 0; j < interp->factor; j++) {
-    free(interp->filter[j].index);
-    free(interp->filter[j].coeff);
-  }
-  free(interp->filter);
   for (j = 0; j < interp->channels; j++) {
     free(interp->z[j]);
   }
@@ -195,14 +308,12 @@ static void interp_process(interpolator* interp, size_t frames, float* in, float
   }
 }
 
-static void ebur128_init_filter(ebur128_state* st) {
-  int i, j;
-
+static void ebur128_design_filter(filter_coeffs* filter) {
   double f0 = 1681.974450955533;
   double G  =    3.999843853973347;
   double Q  =    0.7071752369554196;
 
-  double K  = tan(M_PI * f0 / (double) st->samplerate);
+  double K  = tan(M_PI * f0 / (double) filter->samplerate);
   double Vh = pow(10.0, G / 20.0);
   double Vb = pow(Vh, 0.4996667741545416);
 
@@ -223,30 +334,58 @@ static void ebur128_init_filter(ebur128_state* st) {
 
   f0 = 38.13547087602444;
   Q  =  0.5003270373238773;
-  K  = tan(M_PI * f0 / (double) st->samplerate);
+  K  = tan(M_PI * f0 / (double) filter->samplerate);
 
   ra[1] =   2.0 * (K * K - 1.0) / (1.0 + K / Q + K * K);
   ra[2] = (1.0 - K / Q + K * K) / (1.0 + K / Q + K * K);
 
   /* fprintf(stderr, "%.14f %.14f\n", a2[1], a2[2]); */
 
-  st->d->b[0] = pb[0] * rb[0];
-  st->d->b[1] = pb[0] * rb[1] + pb[1] * rb[0];
-  st->d->b[2] = pb[0] * rb[2] + pb[1] * rb[1] + pb[2] * rb[0];
-  st->d->b[3] = pb[1] * rb[2] + pb[2] * rb[1];
-  st->d->b[4] = pb[2] * rb[2];
+  filter->b[0] = pb[0] * rb[0];
+  filter->b[1] = pb[0] * rb[1] + pb[1] * rb[0];
+  filter->b[2] = pb[0] * rb[2] + pb[1] * rb[1] + pb[2] * rb[0];
+  filter->b[3] = pb[1] * rb[2] + pb[2] * rb[1];
+  filter->b[4] = pb[2] * rb[2];
+
+  filter->a[0] = pa[0] * ra[0];
+  filter->a[1] = pa[0] * ra[1] + pa[1] * ra[0];
+  filter->a[2] = pa[0] * ra[2] + pa[1] * ra[1] + pa[2] * ra[0];
+  filter->a[3] = pa[1] * ra[2] + pa[2] * ra[1];
+  filter->a[4] = pa[2] * ra[2];
+}
 
-  st->d->a[0] = pa[0] * ra[0];
-  st->d->a[1] = pa[0] * ra[1] + pa[1] * ra[0];
-  st->d->a[2] = pa[0] * ra[2] + pa[1] * ra[1] + pa[2] * ra[0];
-  st->d->a[3] = pa[1] * ra[2] + pa[2] * ra[1];
-  st->d->a[4] = pa[2] * ra[2];
+static int ebur128_init_filter(ebur128_state* st) {
+  filter_coeffs* filter;
+  int i, j;
+
+  CACHE_LOCK
+  for (filter = filter_cache; filter; filter = filter->next) {
+    if (filter->samplerate == st->samplerate) break;
+  }
+  if (!filter) {
+    filter = calloc(1, sizeof(filter_coeffs));
+    if (filter) {
+      filter->samplerate = st->samplerate;
+      ebur128_design_filter(filter);
+      filter->next = filter_cache;
+      filter_cache = filter;
+    }
+  }
+  CACHE_UNLOCK
+  if (!filter) return EBUR128_ERROR_NOMEM;
+
+  /* copied, the filter loop reads them next to its own state */
+  for (i = 0; i < 5; ++i) {
+    st->d->b[i] = filter->b[i];
+    st->d->a[i] = filter->a[i];
+  }
 
   for (i = 0; i < 5; ++i) {
     for (j = 0; j < 5; ++j) {
       st->d->v[i][j] = 0.0;
     }
   }
+  return EBUR128_SUCCESS;
 }
 
 static int ebur128_init_channel_map(ebur128_state* st) {
@@ -395,10 +534,12 @@ ebur128_state* ebur128_init(unsigned int channels,
                                        sizeof(double));
   CHECK_ERROR(!st->d->audio_data, 0, free_true_peak)
   for (j = 0; j < st->d->audio_data_frames * st->channels; ++j) {
-    st->d->audio_data[i] = 0.0;
+    st->d->audio_data[j] = 0.0;
   }
 
-  ebur128_init_filter(st);
+  ebur128_init_tables();
+  errcode = ebur128_init_filter(st);
+  CHECK_ERROR(errcode, 0, free_audio_data)
 
   if (st->d->use_histogram) {
     st->d->block_energy_histogram = malloc(1000 * sizeof(unsigned long));
@@ -409,6 +550,8 @@ ebur128_state* ebur128_init(unsigned int channels,
   } else {
     st->d->block_energy_histogram = NULL;
   }
+  st->d->block_energy_sum = 0.0;
+  st->d->block_energy_count = 0;
   if (st->d->use_histogram) {
     st->d->short_term_block_energy_histogram = malloc(1000 * sizeof(unsigned long));
     CHECK_ERROR(!st->d->short_term_block_energy_histogram, 0, free_block_energy_histogram)
@@ -434,19 +577,6 @@ ebur128_state* ebur128_init(unsigned int channels,
   /* start at the beginning of the buffer */
   st->d->audio_data_index = 0;
 
-  /* initialize static constants */
-  relative_gate_factor = pow(10.0, relative_gate / 10.0);
-  minus_twenty_decibels = pow(10.0, -20.0 / 10.0);
-  histogram_energy_boundaries[0] = pow(10.0, (-70.0 + 0.691) / 10.0);
-  if (st->d->use_histogram) {
-    for (i = 0; i < 1000; ++i) {
-      histogram_energies[i] = pow(10.0, ((double) i / 10.0 - 69.95 + 0.691) / 10.0);
-    }
-    for (i = 1; i < 1001; ++i) {
-      histogram_energy_boundaries[i] = pow(10.0, ((double) i / 10.0 - 70.0 + 0.691) / 10.0);
-    }
-  }
-
   return st;
 
 free_short_term_block_energy_histogram:
@@ -667,7 +797,10 @@ static int ebur128_calc_gating_block(ebur128_state* st, size_t frames_per_block,
     return EBUR128_SUCCESS;
   } else if (sum >= histogram_energy_boundaries[0]) {
     if (st->d->use_histogram) {
-      ++st->d->block_energy_histogram[find_histogram_index(sum)];
+      size_t index = find_histogram_index(sum);
+      ++st->d->block_energy_histogram[index];
+      st->d->block_energy_sum += histogram_energies[index];
+      ++st->d->block_energy_count;
     } else {
       struct ebur128_dq_entry* block;
       if (st->d->block_list_size == st->d->block_list_max) {
@@ -746,7 +879,8 @@ int ebur128_change_parameters(ebur128_state* st,
   if (samplerate != st->samplerate) {
     st->samplerate = samplerate;
     st->d->samples_in_100ms = (st->samplerate + 5) / 10;
-    ebur128_init_filter(st);
+    errcode = ebur128_init_filter(st);
+    CHECK_ERROR(errcode, EBUR128_ERROR_NOMEM, exit)
   }
   st->d->audio_data_frames = st->samplerate * st->d->window / 1000;
   if (st->d->audio_data_frames % st->d->samples_in_100ms) {
@@ -934,16 +1068,13 @@ static int ebur128_calc_relative_threshold(ebur128_state* st,
                                            size_t* above_thresh_counter,
                                            double* relative_threshold) {
   struct ebur128_dq_entry* it;
-  size_t i;
   *relative_threshold = 0.0;
   *above_thresh_counter = 0;
 
   if (st->d->use_histogram) {
-    for (i = 0; i < 1000; ++i) {
-      *relative_threshold += st->d->block_energy_histogram[i] *
-                            histogram_energies[i];
-      *above_thresh_counter += st->d->block_energy_histogram[i];
-    }
+    /* kept up to date as the blocks are added */
+    *relative_threshold = st->d->block_energy_sum;
+    *above_thresh_counter = st->d->block_energy_count;
   } else {
     STAILQ_FOREACH(it, &st->d->block_list, entries) {
       ++*above_thresh_counter;
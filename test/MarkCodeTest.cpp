@@ -0,0 +1,100 @@
+/*--------------------------------------------------------------------------------
+ MarkCodeTest.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "../src/MarkCode.h"
+#include "../src/Payload.h"
+
+// Round trip of MarkCode::encode / MarkCode::decode: random payloads are encoded in a
+// batch, up to BeepingRSCodec's 4 symbol errors are injected in each codeword and the
+// batch decode must give back every payload with the number of corrected symbols.
+// Returns the number of failed checks.
+
+static const int kNumCodes = 20000;
+static const int kMaxErrors = (MarkCode::kNumTokens - MarkCode::kNumMessage) / 2;
+
+static uint32_t sState = 20200716;
+
+//xorshift32, the test gives the same cases on every run
+static uint32_t nextRandom()
+{
+  sState ^= sState << 13;
+  sState ^= sState >> 17;
+  sState ^= sState << 5;
+  return sState;
+}
+
+static int sFailures = 0;
+
+static void check(bool condition, const char *what, int n)
+{
+  if (!condition)
+  {
+    if (sFailures < 20)
+      printf("FAILED %s (codeword %d)\n", what, n);
+    sFailures++;
+  }
+}
+
+int main()
+{
+  MarkCode markCode;
+  std::vector<Payload> payloads(kNumCodes);
+  std::vector<Payload> decoded(kNumCodes);
+  std::vector<uint8_t> codes((size_t)kNumCodes * MarkCode::kNumTokens);
+  std::vector<int> errors(kNumCodes);
+  std::vector<int> status(kNumCodes);
+
+  for (int n = 0; n < kNumCodes; n++)
+    payloads[n] = Payload(((uint64_t)nextRandom() << 32) | nextRandom());
+  markCode.encode(payloads.data(), kNumCodes, codes.data());
+
+  //clean codewords, decoded without the optional status
+  int failed = markCode.decode(codes.data(), kNumCodes, decoded.data(), NULL);
+  check(failed == 0, "clean codewords decode", -1);
+  for (int n = 0; n < kNumCodes; n++)
+    check(decoded[n] == payloads[n], "clean payload", n);
+
+  //0 to kMaxErrors symbol errors at distinct positions, front door and parity included
+  for (int n = 0; n < kNumCodes; n++)
+  {
+    uint8_t *code = &codes[(size_t)n * MarkCode::kNumTokens];
+    errors[n] = n % (kMaxErrors + 1);
+    bool used[MarkCode::kNumTokens] = { false };
+    for (int e = 0; e < errors[n]; e++)
+    {
+      int position;
+      do
+        position = (int)(nextRandom() % MarkCode::kNumTokens);
+      while (used[position]);
+      used[position] = true;
+      code[position] ^= (uint8_t)(1 + nextRandom() % 31); //nonzero error, stays in 0..31
+    }
+  }
+  failed = markCode.decode(codes.data(), kNumCodes, decoded.data(), status.data());
+  check(failed == 0, "corrupted codewords decode", -1);
+  for (int n = 0; n < kNumCodes; n++)
+  {
+    check(status[n] == errors[n], "number of corrected symbols", n);
+    check(decoded[n] == payloads[n], "corrected payload", n);
+  }
+
+  //a valid Reed-Solomon codeword with a wrong front door is not a mark
+  BeepingRSCodec codec;
+  uint8_t message[MarkCode::kNumMessage] = { 2, 24 };
+  uint8_t code[MarkCode::kNumTokens];
+  codec.encode(message, 1, code);
+  Payload payload;
+  int codeStatus = 0;
+  failed = markCode.decode(code, 1, &payload, &codeStatus);
+  check((failed == 1) && (codeStatus == -1), "wrong front door rejected", 0);
+
+  printf("MarkCodeTest: %d codewords, %d failed checks\n", kNumCodes, sFailures);
+  return (sFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/*--------------------------------------------------------------------------------
+ ToneSynthTest.cpp
+ Version 1.1.0
+ Apache Lisence 2.0
+ --------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+#include "BeepingCoreLib_api.h"
+#include "../src/MarkEncoder.h"
+#include "../src/ToneSynth.h"
+#include "../src/Payload.h"
+
+// ToneSynth against BeepingCore: the same payloads are rendered by BEEPING_EncodeDataToAudioBuffer
+// (through CoreMarkEncoder) and by ToneSynth for every multi-tone mode at 44.1 and 48 kHz, and
+// every sample must stay within kMaxError of the core. Marks are rendered back to back, so
+// the phase of one mark cannot leak into the next. Returns the number of failed checks.
+
+static const int kNumMarks = 50;
+static const int kBufferSize = 1024;
+static const double kMaxError = 1e-3; // same bound as the --synthcheck option
+
+static uint32_t sState = 20200716;
+
+//xorshift32, the test gives the same cases on every run
+static uint32_t nextRandom()
+{
+  sState ^= sState << 13;
+  sState ^= sState >> 17;
+  sState ^= sState << 5;
+  return sState;
+}
+
+static int sFailures = 0;
+
+static void check(bool condition, const char *what, int mode, float samplingRate, int n)
+{
+  if (!condition)
+  {
+    if (sFailures < 20)
+      printf("FAILED %s (mode %d, %g Hz, mark %d)\n", what, mode, samplingRate, n);
+    sFailures++;
+  }
+}
+
+// returns the largest difference of all the marks of one configuration
+static double compareMode(int mode, float samplingRate)
+{
+  const float customBaseFreq = 12000.f;
+  const int tonesSeparation = 1;
+
+  void *beepingCore = BEEPING_Create();
+  if (mode == BEEPING_MODE_CUSTOM)
+    BEEPING_SetCustomBaseFreq(customBaseFreq, tonesSeparation, beepingCore);
+  BEEPING_SetSynthMode(0, beepingCore);
+  BEEPING_Configure(mode, samplingRate, kBufferSize, beepingCore);
+
+  ToneSynth toneSynth;
+  check(toneSynth.configure(mode, samplingRate, customBaseFreq, tonesSeparation) == 0, "configure", mode, samplingRate, -1);
+
+  double maxDiff = 0.0;
+  {
+    CoreMarkEncoder coreEncoder(beepingCore, samplingRate, kBufferSize, 0);
+    std::vector<float> coreMark(coreEncoder.getMaxMarkSamples());
+    std::vector<float> nativeMark(toneSynth.getMaxMarkSamples());
+
+    for (int n = 0; n < kNumMarks; n++)
+    {
+      Payload payload(((uint64_t)nextRandom() << 32) | nextRandom());
+      int coreSamples = coreEncoder.render(payload, &coreMark[0], 1.f);
+      int nativeSamples = toneSynth.render(payload, &nativeMark[0], 1.f);
+      check(coreSamples == nativeSamples, "mark length", mode, samplingRate, n);
+
+      double diff = 0.0;
+      for (int i = 0; i < ((coreSamples < nativeSamples) ? coreSamples : nativeSamples); i++)
+      {
+        double d = fabs(coreMark[i] - nativeMark[i]);
+        if (d > diff)
+          diff = d;
+      }
+      check(diff < kMaxError, "samples", mode, samplingRate, n);
+      if (diff > maxDiff)
+        maxDiff = diff;
+    }
+  }
+
+  BEEPING_Destroy(beepingCore);
+  return maxDiff;
+}
+
+int main()
+{
+  const int modes[] = { BEEPING_MODE_AUDIBLE, BEEPING_MODE_NONAUDIBLE, BEEPING_MODE_HIDDEN, BEEPING_MODE_CUSTOM };
+  const float samplingRates[] = { 44100.f, 48000.f };
+
+  for (int m = 0; m < 4; m++)
+  {
+    for (int r = 0; r < 2; r++)
+    {
+      double maxDiff = compareMode(modes[m], samplingRates[r]);
+      printf("ToneSynthTest: mode %d, %g Hz, max difference %g\n", modes[m], samplingRates[r], maxDiff);
+    }
+  }
+
+  printf("ToneSynthTest: %d marks, %d failed checks\n", 8 * kNumMarks, sFailures);
+  return (sFailures == 0) ? 0 : 1;
+}